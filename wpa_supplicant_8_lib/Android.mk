@@ -36,6 +36,15 @@ WPA_SUPPL_DIR_INCLUDE = $(WPA_SUPPL_DIR)/src \
 
 ifdef CONFIG_DRIVER_WEXT
 WPA_SRC_FILE += driver_cmd_wext.c
+WPA_SRC_FILE += driver_cmd_scan_delta.c
+WPA_SRC_FILE += driver_cmd_sig_hist.c
+WPA_SRC_FILE += driver_cmd_scan_cost.c
+WPA_SRC_FILE += driver_cmd_metrics.c
+WPA_SRC_FILE += driver_cmd_events.c
+WPA_SRC_FILE += driver_cmd_mobility.c
+WPA_SRC_FILE += driver_cmd_predict.c
+WPA_SRC_FILE += driver_cmd_profile.c
+WPA_SRC_FILE += driver_cmd_signal.c
 endif
 
 # To force sizeof(enum) = 4
@@ -57,4 +66,18 @@ include $(BUILD_STATIC_LIBRARY)
 
 ########################
 
+ifdef CONFIG_DRIVER_WEXT
+include $(CLEAR_VARS)
+LOCAL_MODULE := driver_cmd_events_bench
+LOCAL_MODULE_TAGS := optional
+LOCAL_SHARED_LIBRARIES := libc libcutils libwpa_client
+LOCAL_STATIC_LIBRARIES := lib_driver_cmd
+LOCAL_CFLAGS := -mabi=aapcs-linux
+LOCAL_SRC_FILES := driver_cmd_events_bench.c
+LOCAL_C_INCLUDES := $(WPA_SUPPL_DIR_INCLUDE)
+include $(BUILD_EXECUTABLE)
+endif
+
+########################
+
 endif
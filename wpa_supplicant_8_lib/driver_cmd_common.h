@@ -36,6 +36,10 @@
 #define WEXT_PNO_SCAN_INTERVAL_SECTION	'T'
 #define WEXT_PNO_SCAN_INTERVAL_LENGTH	2
 #define WEXT_PNO_SCAN_INTERVAL		30
+/* Smallest scan interval that fills WEXT_PNO_SCAN_INTERVAL_LENGTH hex digits */
+#define WEXT_PNO_SCAN_INTERVAL_MIN	0x10
+/* Largest scan interval that fits in WEXT_PNO_SCAN_INTERVAL_LENGTH hex digits */
+#define WEXT_PNO_SCAN_INTERVAL_MAX	0xff
 /* Scan interval size is scan interval section type + scan interval length above*/
 #define WEXT_PNO_SCAN_INTERVAL_SIZE	(1 + WEXT_PNO_SCAN_INTERVAL_LENGTH)
 #define WEXT_PNO_REPEAT_SECTION		'R'
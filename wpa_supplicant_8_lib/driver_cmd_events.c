@@ -0,0 +1,314 @@
+/*
+ * Driver interaction for private interface - driver event subscriptions
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 2 as
+ * published by the Free Software Foundation.
+ *
+ * Alternatively, this software may be distributed under the terms of BSD
+ * license.
+ *
+ */
+
+#include "includes.h"
+#include <sys/eventfd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <sys/un.h>
+#include <cutils/ashmem.h>
+
+#include "common.h"
+#include "eloop.h"
+
+#include "driver_cmd_events.h"
+
+struct events_subscriber {
+	int sock;
+	int efd;
+	int shm_fd;
+	struct driver_event_ring *ring;
+	u32 mask;
+};
+
+static const int events_rssi_thresholds[] = EVENTS_RSSI_THRESHOLDS;
+
+static struct {
+	int sock;
+	int initialized;
+	void (*subscribe_cb)(void);
+	struct events_subscriber subs[EVENTS_MAX_SUBSCRIBERS];
+	/* Bit n set while the RSSI is above events_rssi_thresholds[n] */
+	u32 rssi_above;
+	int rssi_valid;
+} events;
+
+static void events_subscriber_free(struct events_subscriber *sub)
+{
+	eloop_unregister_read_sock(sub->sock);
+	close(sub->sock);
+	if (sub->ring)
+		munmap(sub->ring, sizeof(*sub->ring));
+	if (sub->shm_fd >= 0)
+		close(sub->shm_fd);
+	if (sub->efd >= 0)
+		close(sub->efd);
+	os_memset(sub, 0, sizeof(*sub));
+	sub->sock = -1;
+}
+
+static int events_subscriber_setup(struct events_subscriber *sub)
+{
+	struct msghdr msg;
+	struct iovec iov;
+	struct cmsghdr *cmsg;
+	char control[CMSG_SPACE(2 * sizeof(int))];
+	char reply = 0;
+	int *fds;
+
+	sub->efd = eventfd(0, EFD_NONBLOCK);
+	sub->shm_fd = ashmem_create_region("driver_events", sizeof(*sub->ring));
+	if (sub->efd < 0 || sub->shm_fd < 0)
+		return -1;
+	sub->ring = mmap(NULL, sizeof(*sub->ring), PROT_READ | PROT_WRITE,
+			 MAP_SHARED, sub->shm_fd, 0);
+	if (sub->ring == MAP_FAILED) {
+		sub->ring = NULL;
+		return -1;
+	}
+	os_memset(sub->ring, 0, sizeof(*sub->ring));
+	sub->ring->magic = EVENTS_RING_MAGIC;
+	sub->ring->version = EVENTS_VERSION;
+	sub->ring->size = EVENTS_RING_SIZE;
+
+	os_memset(&msg, 0, sizeof(msg));
+	iov.iov_base = &reply;
+	iov.iov_len = sizeof(reply);
+	msg.msg_iov = &iov;
+	msg.msg_iovlen = 1;
+	msg.msg_control = control;
+	msg.msg_controllen = sizeof(control);
+	cmsg = CMSG_FIRSTHDR(&msg);
+	cmsg->cmsg_level = SOL_SOCKET;
+	cmsg->cmsg_type = SCM_RIGHTS;
+	cmsg->cmsg_len = CMSG_LEN(2 * sizeof(int));
+	fds = (int *) CMSG_DATA(cmsg);
+	fds[0] = sub->efd;
+	fds[1] = sub->shm_fd;
+
+	if (sendmsg(sub->sock, &msg, MSG_NOSIGNAL) < 0)
+		return -1;
+	return 0;
+}
+
+static void events_receive(int sock, void *eloop_ctx, void *sock_ctx)
+{
+	struct events_subscriber *sub = eloop_ctx;
+	struct driver_event_subscribe req;
+	int len;
+
+	len = recv(sock, &req, sizeof(req), 0);
+	if (len != sizeof(req) || req.version != EVENTS_VERSION) {
+		wpa_printf(MSG_DEBUG, "%s: subscriber %d gone", __func__, sock);
+		events_subscriber_free(sub);
+		return;
+	}
+
+	if (sub->ring == NULL && events_subscriber_setup(sub) < 0) {
+		wpa_printf(MSG_ERROR, "%s: failed to set up subscriber: %s",
+			   __func__, strerror(errno));
+		events_subscriber_free(sub);
+		return;
+	}
+	sub->mask = req.mask;
+	wpa_printf(MSG_DEBUG, "%s: subscriber %d mask 0x%x", __func__, sock,
+		   sub->mask);
+	if (events.subscribe_cb)
+		events.subscribe_cb();
+}
+
+static void events_accept(int sock, void *eloop_ctx, void *sock_ctx)
+{
+	struct events_subscriber *sub = NULL;
+	int fd, i;
+
+	fd = accept(sock, NULL, NULL);
+	if (fd < 0)
+		return;
+
+	for (i = 0; i < EVENTS_MAX_SUBSCRIBERS; i++) {
+		if (events.subs[i].sock < 0) {
+			sub = &events.subs[i];
+			break;
+		}
+	}
+	if (sub == NULL) {
+		wpa_printf(MSG_ERROR, "%s: too many subscribers", __func__);
+		close(fd);
+		return;
+	}
+
+	sub->sock = fd;
+	sub->efd = -1;
+	sub->shm_fd = -1;
+	eloop_register_read_sock(fd, events_receive, sub, NULL);
+}
+
+/**
+ * wpa_driver_events_init - Start accepting event subscribers
+ * @ifname: Interface name used in the socket name
+ * @subscribe_cb: Called when a subscriber has set its event mask, so event
+ *	sources that only run while subscribed can start
+ * Returns: 0 on success, -1 on failure
+ *
+ * Only the first call does anything.
+ */
+int wpa_driver_events_init(const char *ifname, void (*subscribe_cb)(void))
+{
+	struct sockaddr_un addr;
+	int i;
+
+	if (events.initialized)
+		return 0;
+	events.initialized = 1;
+	events.subscribe_cb = subscribe_cb;
+	for (i = 0; i < EVENTS_MAX_SUBSCRIBERS; i++)
+		events.subs[i].sock = -1;
+
+	os_memset(&addr, 0, sizeof(addr));
+	addr.sun_family = AF_UNIX;
+	os_snprintf(addr.sun_path, sizeof(addr.sun_path), "%s/%s%s",
+		    EVENTS_SOCKET_DIR, EVENTS_SOCKET_PREFIX, ifname);
+
+	events.sock = socket(PF_UNIX, SOCK_SEQPACKET, 0);
+	if (events.sock < 0) {
+		wpa_printf(MSG_ERROR, "%s: socket: %s", __func__,
+			   strerror(errno));
+		return -1;
+	}
+	unlink(addr.sun_path);
+	if (bind(events.sock, (struct sockaddr *) &addr, sizeof(addr)) < 0 ||
+	    chmod(addr.sun_path, S_IRWXU | S_IRWXG) < 0 ||
+	    listen(events.sock, EVENTS_MAX_SUBSCRIBERS) < 0) {
+		wpa_printf(MSG_ERROR, "%s: %s: %s", __func__, addr.sun_path,
+			   strerror(errno));
+		close(events.sock);
+		events.sock = -1;
+		return -1;
+	}
+
+	eloop_register_read_sock(events.sock, events_accept, NULL, NULL);
+	wpa_printf(MSG_DEBUG, "%s: accepting subscribers on %s", __func__,
+		   addr.sun_path);
+	return 0;
+}
+
+/**
+ * wpa_driver_events_subscribed - Check whether an event type has subscribers
+ * @type: DRIVER_EVENT_* type
+ * Returns: 1 if at least one subscriber receives @type events, else 0
+ */
+int wpa_driver_events_subscribed(u16 type)
+{
+	int i;
+
+	for (i = 0; i < EVENTS_MAX_SUBSCRIBERS; i++) {
+		if (events.subs[i].ring && (events.subs[i].mask & BIT(type)))
+			return 1;
+	}
+	return 0;
+}
+
+/**
+ * wpa_driver_events_publish - Deliver an event to its subscribers
+ * @type: DRIVER_EVENT_* type
+ * @flags: DRIVER_EVENT_FLAG_* flags
+ * @value: Type specific value
+ * @arg: Type specific argument
+ *
+ * Only subscribers of @type are woken up. This never blocks: if a ring is
+ * full, the event is dropped for that subscriber.
+ */
+void wpa_driver_events_publish(u16 type, u16 flags, int value, int arg)
+{
+	struct events_subscriber *sub;
+	struct driver_event *ev;
+	struct timespec ts;
+	u64 one = 1;
+	u32 head;
+	int i, have_ts = 0;
+
+	for (i = 0; i < EVENTS_MAX_SUBSCRIBERS; i++) {
+		sub = &events.subs[i];
+		if (sub->ring == NULL || !(sub->mask & BIT(type)))
+			continue;
+
+		head = sub->ring->head;
+		if (head - __atomic_load_n(&sub->ring->tail, __ATOMIC_ACQUIRE) >=
+		    EVENTS_RING_SIZE) {
+			sub->ring->dropped++;
+			continue;
+		}
+		if (!have_ts) {
+			clock_gettime(CLOCK_MONOTONIC, &ts);
+			have_ts = 1;
+		}
+		ev = &sub->ring->events[head & (EVENTS_RING_SIZE - 1)];
+		ev->timestamp_ns = (u64) ts.tv_sec * 1000000000 + ts.tv_nsec;
+		ev->type = type;
+		ev->flags = flags;
+		ev->value = value;
+		ev->arg = arg;
+		__atomic_store_n(&sub->ring->head, head + 1, __ATOMIC_RELEASE);
+
+		if (write(sub->efd, &one, sizeof(one)) < 0)
+			wpa_printf(MSG_DEBUG, "%s: eventfd write: %s",
+				   __func__, strerror(errno));
+	}
+}
+
+/**
+ * wpa_driver_events_rssi - Report RSSI threshold crossings
+ * @rssi: Current RSSI in dBm
+ *
+ * A threshold is crossed when the RSSI moves EVENTS_RSSI_HYST dB past it, so
+ * a signal hovering around a threshold does not generate an event stream.
+ */
+void wpa_driver_events_rssi(int rssi)
+{
+	unsigned int i;
+	int threshold;
+
+	for (i = 0; i < ARRAY_SIZE(events_rssi_thresholds); i++) {
+		threshold = events_rssi_thresholds[i];
+		if (!events.rssi_valid) {
+			if (rssi > threshold)
+				events.rssi_above |= BIT(i);
+			continue;
+		}
+		if (!(events.rssi_above & BIT(i)) &&
+		    rssi >= threshold + EVENTS_RSSI_HYST) {
+			events.rssi_above |= BIT(i);
+			wpa_driver_events_publish(DRIVER_EVENT_RSSI,
+						  DRIVER_EVENT_FLAG_RISING,
+						  rssi, threshold);
+		} else if ((events.rssi_above & BIT(i)) &&
+			   rssi <= threshold - EVENTS_RSSI_HYST) {
+			events.rssi_above &= ~BIT(i);
+			wpa_driver_events_publish(DRIVER_EVENT_RSSI, 0, rssi,
+						  threshold);
+		}
+	}
+	events.rssi_valid = 1;
+}
+
+/**
+ * wpa_driver_events_rssi_reset - Forget the RSSI after the link went down
+ *
+ * The first RSSI of the next link only sets the threshold state, it is not
+ * compared against the RSSI of the previous AP.
+ */
+void wpa_driver_events_rssi_reset(void)
+{
+	events.rssi_valid = 0;
+	events.rssi_above = 0;
+}
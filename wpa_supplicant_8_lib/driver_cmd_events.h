@@ -0,0 +1,84 @@
+/*
+ * Driver interaction for private interface - driver event subscriptions
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 2 as
+ * published by the Free Software Foundation.
+ *
+ * Alternatively, this software may be distributed under the terms of BSD
+ * license.
+ *
+ */
+#ifndef DRIVER_CMD_EVENTS_H
+#define DRIVER_CMD_EVENTS_H
+
+/*
+ * Subscribers connect to EVENTS_SOCKET_DIR/EVENTS_SOCKET_PREFIX<ifname> and
+ * send a struct driver_event_subscribe. The reply is a single byte carrying
+ * two file descriptors: an eventfd and a shared memory region holding a
+ * struct driver_event_ring. Sending another subscribe message changes the
+ * event mask and closing the connection ends the subscription.
+ */
+#define EVENTS_SOCKET_DIR		"/data/misc/wifi/sockets"
+#define EVENTS_SOCKET_PREFIX		"events-"
+#define EVENTS_MAX_SUBSCRIBERS		8
+#define EVENTS_RING_MAGIC		0x52564544
+#define EVENTS_VERSION			1
+/* Number of events in a ring, must be a power of two */
+#define EVENTS_RING_SIZE		64
+
+/* Event types, also used as bit numbers in the subscription mask */
+#define DRIVER_EVENT_HANGED		0
+#define DRIVER_EVENT_STATE		1 /* value: 1 started, 0 stopped */
+/*
+ * value: number of BSSes. Results of scans requested through the library
+ * are reported as soon as wpa_supplicant has processed them, results of PNO
+ * scans the firmware does on its own only when the library is called next.
+ */
+#define DRIVER_EVENT_SCAN_RESULTS	2
+#define DRIVER_EVENT_RSSI		3 /* value: RSSI, arg: threshold */
+#define DRIVER_EVENT_MOBILITY		4 /* value: enum mobility_state */
+
+/* RSSI thresholds (dBm) reported by DRIVER_EVENT_RSSI when crossed */
+#define EVENTS_RSSI_THRESHOLDS		{ -85, -75, -65 }
+#define EVENTS_RSSI_HYST		2
+/* Set in driver_event flags when the RSSI went above the threshold */
+#define DRIVER_EVENT_FLAG_RISING	0x0001
+
+struct driver_event_subscribe {
+	u32 version;
+	u32 mask;
+};
+
+struct driver_event {
+	/* CLOCK_MONOTONIC time the event was published */
+	u64 timestamp_ns;
+	u16 type;
+	u16 flags;
+	s32 value;
+	s32 arg;
+	u32 reserved;
+};
+
+/*
+ * Single producer, single consumer ring. The producer only writes head and
+ * the consumer only writes tail; events are dropped (and counted) instead of
+ * waiting when the consumer falls EVENTS_RING_SIZE events behind.
+ */
+struct driver_event_ring {
+	u32 magic;
+	u32 version;
+	u32 size;
+	u32 head;
+	u32 tail;
+	u32 dropped;
+	struct driver_event events[EVENTS_RING_SIZE];
+};
+
+int wpa_driver_events_init(const char *ifname, void (*subscribe_cb)(void));
+int wpa_driver_events_subscribed(u16 type);
+void wpa_driver_events_publish(u16 type, u16 flags, int value, int arg);
+void wpa_driver_events_rssi(int rssi);
+void wpa_driver_events_rssi_reset(void);
+
+#endif /* DRIVER_CMD_EVENTS_H */
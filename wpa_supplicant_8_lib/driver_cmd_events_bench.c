@@ -0,0 +1,474 @@
+/*
+ * Driver interaction for private interface - driver event delivery benchmark
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 2 as
+ * published by the Free Software Foundation.
+ *
+ * Alternatively, this software may be distributed under the terms of BSD
+ * license.
+ *
+ */
+
+#include "includes.h"
+#include <poll.h>
+#include <sys/mman.h>
+#include <sys/resource.h>
+#include <sys/un.h>
+#include <sys/wait.h>
+
+#include "common.h"
+#include "eloop.h"
+#include "wpa_ctrl.h"
+
+#include "driver_cmd_events.h"
+
+/*
+ * Delivers the same RSSI event stream to a subscriber once through the
+ * driver event ring and once the way wpa_supplicant delivers events to an
+ * attached control interface monitor: formatted as text and sent as a
+ * datagram. The subscriber runs in a child process and measures the delivery
+ * latency of every event from the CLOCK_MONOTONIC time it was published; both
+ * processes measure the CPU time they used per event.
+ *
+ * Usage: driver_cmd_events_bench [events] [interval_us]
+ */
+#define BENCH_EVENTS		20000
+#define BENCH_INTERVAL_US	500
+#define BENCH_IFNAME		"bench"
+#define BENCH_CTRL_PATH		EVENTS_SOCKET_DIR "/bench-ctrl"
+#define BENCH_MAX_SOCKS		(EVENTS_MAX_SUBSCRIBERS + 1)
+
+struct bench_result {
+	unsigned int received;
+	unsigned int dropped;
+	unsigned long long lat_sum_ns;
+	unsigned long long lat_p50_ns;
+	unsigned long long lat_p99_ns;
+	unsigned long long lat_max_ns;
+	unsigned long long cpu_ns;
+};
+
+/* The part of eloop the event code uses, driven by bench_eloop_poll() */
+static struct {
+	int sock;
+	eloop_sock_handler handler;
+	void *eloop_data;
+	void *user_data;
+} bench_socks[BENCH_MAX_SOCKS];
+
+int eloop_register_read_sock(int sock, eloop_sock_handler handler,
+			     void *eloop_data, void *user_data)
+{
+	int i;
+
+	for (i = 0; i < BENCH_MAX_SOCKS; i++) {
+		if (bench_socks[i].handler == NULL) {
+			bench_socks[i].sock = sock;
+			bench_socks[i].handler = handler;
+			bench_socks[i].eloop_data = eloop_data;
+			bench_socks[i].user_data = user_data;
+			return 0;
+		}
+	}
+	return -1;
+}
+
+void eloop_unregister_read_sock(int sock)
+{
+	int i;
+
+	for (i = 0; i < BENCH_MAX_SOCKS; i++) {
+		if (bench_socks[i].handler && bench_socks[i].sock == sock)
+			bench_socks[i].handler = NULL;
+	}
+}
+
+void wpa_printf(int level, const char *fmt, ...)
+{
+	va_list ap;
+
+	if (level < MSG_ERROR)
+		return;
+	va_start(ap, fmt);
+	vfprintf(stderr, fmt, ap);
+	va_end(ap);
+	fprintf(stderr, "\n");
+}
+
+static void bench_eloop_poll(int timeout_ms)
+{
+	struct pollfd pfd[BENCH_MAX_SOCKS];
+	int idx[BENCH_MAX_SOCKS];
+	int i, n = 0;
+
+	for (i = 0; i < BENCH_MAX_SOCKS; i++) {
+		if (bench_socks[i].handler == NULL)
+			continue;
+		pfd[n].fd = bench_socks[i].sock;
+		pfd[n].events = POLLIN;
+		idx[n++] = i;
+	}
+	if (poll(pfd, n, timeout_ms) <= 0)
+		return;
+	for (i = 0; i < n; i++) {
+		if ((pfd[i].revents & (POLLIN | POLLHUP)) &&
+		    bench_socks[idx[i]].handler &&
+		    bench_socks[idx[i]].sock == pfd[i].fd)
+			bench_socks[idx[i]].handler(pfd[i].fd,
+						    bench_socks[idx[i]].eloop_data,
+						    bench_socks[idx[i]].user_data);
+	}
+}
+
+static unsigned long long bench_now_ns(void)
+{
+	struct timespec ts;
+
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return (unsigned long long) ts.tv_sec * 1000000000 + ts.tv_nsec;
+}
+
+static unsigned long long bench_cpu_ns(void)
+{
+	struct rusage ru;
+
+	getrusage(RUSAGE_SELF, &ru);
+	return ((unsigned long long) ru.ru_utime.tv_sec + ru.ru_stime.tv_sec) *
+		1000000000 + ((unsigned long long) ru.ru_utime.tv_usec +
+			      ru.ru_stime.tv_usec) * 1000;
+}
+
+static int bench_cmp(const void *a, const void *b)
+{
+	unsigned long long x = *(const unsigned long long *) a;
+	unsigned long long y = *(const unsigned long long *) b;
+
+	return x < y ? -1 : x > y;
+}
+
+static void bench_finish(struct bench_result *res, unsigned long long *lat,
+			 unsigned long long cpu_start)
+{
+	unsigned int i;
+
+	res->cpu_ns = bench_cpu_ns() - cpu_start;
+	if (res->received == 0)
+		return;
+	qsort(lat, res->received, sizeof(*lat), bench_cmp);
+	for (i = 0; i < res->received; i++)
+		res->lat_sum_ns += lat[i];
+	res->lat_p50_ns = lat[res->received / 2];
+	res->lat_p99_ns = lat[(unsigned long long) res->received * 99 / 100];
+	res->lat_max_ns = lat[res->received - 1];
+}
+
+/* Subscriber side of the event ring, in the child */
+static int bench_ring_receive(unsigned int events, struct bench_result *res)
+{
+	struct sockaddr_un addr;
+	struct driver_event_subscribe req;
+	struct driver_event_ring *ring;
+	struct driver_event *ev;
+	struct msghdr msg;
+	struct iovec iov;
+	struct cmsghdr *cmsg;
+	struct pollfd pfd;
+	char control[CMSG_SPACE(2 * sizeof(int))];
+	unsigned long long *lat, cpu_start, count;
+	int sock, efd, shm_fd, done = 0;
+	char reply;
+	u32 tail;
+
+	os_memset(&addr, 0, sizeof(addr));
+	addr.sun_family = AF_UNIX;
+	os_snprintf(addr.sun_path, sizeof(addr.sun_path), "%s/%s%s",
+		    EVENTS_SOCKET_DIR, EVENTS_SOCKET_PREFIX, BENCH_IFNAME);
+	sock = socket(PF_UNIX, SOCK_SEQPACKET, 0);
+	if (sock < 0 ||
+	    connect(sock, (struct sockaddr *) &addr, sizeof(addr)) < 0)
+		return -1;
+	req.version = EVENTS_VERSION;
+	req.mask = BIT(DRIVER_EVENT_RSSI);
+	if (send(sock, &req, sizeof(req), 0) != sizeof(req))
+		return -1;
+
+	os_memset(&msg, 0, sizeof(msg));
+	iov.iov_base = &reply;
+	iov.iov_len = sizeof(reply);
+	msg.msg_iov = &iov;
+	msg.msg_iovlen = 1;
+	msg.msg_control = control;
+	msg.msg_controllen = sizeof(control);
+	if (recvmsg(sock, &msg, 0) < 0)
+		return -1;
+	cmsg = CMSG_FIRSTHDR(&msg);
+	if (cmsg == NULL || cmsg->cmsg_type != SCM_RIGHTS)
+		return -1;
+	efd = ((int *) CMSG_DATA(cmsg))[0];
+	shm_fd = ((int *) CMSG_DATA(cmsg))[1];
+	ring = mmap(NULL, sizeof(*ring), PROT_READ | PROT_WRITE, MAP_SHARED,
+		    shm_fd, 0);
+	if (ring == MAP_FAILED || ring->magic != EVENTS_RING_MAGIC)
+		return -1;
+
+	lat = os_zalloc(events * sizeof(*lat));
+	if (lat == NULL)
+		return -1;
+	cpu_start = bench_cpu_ns();
+	pfd.fd = efd;
+	pfd.events = POLLIN;
+	while (!done && poll(&pfd, 1, 5000) > 0) {
+		if (read(efd, &count, sizeof(count)) < 0)
+			continue;
+		tail = ring->tail;
+		while (tail != __atomic_load_n(&ring->head, __ATOMIC_ACQUIRE)) {
+			ev = &ring->events[tail & (ring->size - 1)];
+			if (res->received < events)
+				lat[res->received++] = bench_now_ns() -
+					ev->timestamp_ns;
+			if ((unsigned int) ev->arg == events - 1)
+				done = 1;
+			__atomic_store_n(&ring->tail, ++tail,
+					 __ATOMIC_RELEASE);
+		}
+	}
+	res->dropped = ring->dropped;
+	bench_finish(res, lat, cpu_start);
+	os_free(lat);
+	return 0;
+}
+
+/* Monitor side of the control interface, in the child */
+static int bench_ctrl_receive(unsigned int events, struct bench_result *res)
+{
+	struct wpa_ctrl *ctrl;
+	struct pollfd pfd;
+	unsigned long long *lat, cpu_start, ts;
+	char buf[256];
+	size_t len;
+	unsigned int seq;
+	int done = 0;
+
+	ctrl = wpa_ctrl_open(BENCH_CTRL_PATH);
+	if (ctrl == NULL || wpa_ctrl_attach(ctrl) < 0)
+		return -1;
+
+	lat = os_zalloc(events * sizeof(*lat));
+	if (lat == NULL)
+		return -1;
+	cpu_start = bench_cpu_ns();
+	pfd.fd = wpa_ctrl_get_fd(ctrl);
+	pfd.events = POLLIN;
+	while (!done && poll(&pfd, 1, 5000) > 0) {
+		len = sizeof(buf) - 1;
+		if (wpa_ctrl_recv(ctrl, buf, &len) < 0)
+			continue;
+		buf[len] = '\0';
+		if (sscanf(buf, "<%*d>CTRL-EVENT-BENCH seq=%u ts=%llu", &seq,
+			   &ts) != 2)
+			continue;
+		if (res->received < events)
+			lat[res->received++] = bench_now_ns() - ts;
+		if (seq == events - 1)
+			done = 1;
+	}
+	res->dropped = events - res->received;
+	bench_finish(res, lat, cpu_start);
+	os_free(lat);
+	wpa_ctrl_close(ctrl);
+	return 0;
+}
+
+static pid_t bench_fork(int ctrl, unsigned int events, int *pipe_fd)
+{
+	struct bench_result res;
+	int fds[2], ret;
+	pid_t pid;
+
+	if (pipe(fds) < 0)
+		return -1;
+	pid = fork();
+	if (pid != 0) {
+		close(fds[1]);
+		*pipe_fd = fds[0];
+		return pid;
+	}
+
+	close(fds[0]);
+	os_memset(&res, 0, sizeof(res));
+	ret = ctrl ? bench_ctrl_receive(events, &res) :
+		bench_ring_receive(events, &res);
+	if (ret < 0)
+		perror(ctrl ? "ctrl subscriber" : "ring subscriber");
+	if (write(fds[1], &res, sizeof(res)) != sizeof(res))
+		ret = -1;
+	_exit(ret < 0);
+}
+
+static int bench_collect(pid_t pid, int pipe_fd, struct bench_result *res)
+{
+	int status, ret;
+
+	ret = read(pipe_fd, res, sizeof(*res));
+	close(pipe_fd);
+	if (waitpid(pid, &status, 0) < 0 || !WIFEXITED(status) ||
+	    WEXITSTATUS(status) != 0 || ret != sizeof(*res))
+		return -1;
+	return 0;
+}
+
+static void bench_report(const char *name, unsigned int events,
+			 unsigned long long producer_cpu_ns,
+			 const struct bench_result *res)
+{
+	printf("%-5s events=%u received=%u dropped=%u lat_mean_us=%llu "
+	       "lat_p50_us=%llu lat_p99_us=%llu lat_max_us=%llu "
+	       "producer_cpu_ns_per_event=%llu "
+	       "subscriber_cpu_ns_per_event=%llu\n", name, events,
+	       res->received, res->dropped,
+	       res->received ? res->lat_sum_ns / res->received / 1000 : 0,
+	       res->lat_p50_ns / 1000, res->lat_p99_ns / 1000,
+	       res->lat_max_ns / 1000, producer_cpu_ns / events,
+	       res->received ? res->cpu_ns / res->received : 0);
+}
+
+static int bench_ring(unsigned int events, unsigned int interval_us)
+{
+	struct bench_result res;
+	unsigned long long cpu;
+	unsigned int i;
+	int pipe_fd;
+	pid_t pid;
+
+	if (wpa_driver_events_init(BENCH_IFNAME, NULL) < 0)
+		return -1;
+	pid = bench_fork(0, events, &pipe_fd);
+	if (pid < 0)
+		return -1;
+	for (i = 0; i < 500 && !wpa_driver_events_subscribed(DRIVER_EVENT_RSSI);
+	     i++)
+		bench_eloop_poll(10);
+
+	cpu = bench_cpu_ns();
+	for (i = 0; i < events; i++) {
+		wpa_driver_events_publish(DRIVER_EVENT_RSSI, 0, -60, i);
+		usleep(interval_us);
+	}
+	cpu = bench_cpu_ns() - cpu;
+
+	if (bench_collect(pid, pipe_fd, &res) < 0)
+		return -1;
+	bench_report("ring", events, cpu, &res);
+	return 0;
+}
+
+/*
+ * Send an event to the attached monitor the way wpa_msg() and
+ * wpa_supplicant_ctrl_iface_send() do: format the text, then send the level
+ * prefix and the text in one datagram.
+ */
+static void bench_ctrl_send(int sock, struct sockaddr_un *dst, unsigned int seq)
+{
+	struct msghdr msg;
+	struct iovec io[3];
+	char levelstr[10], buf[128];
+	int len;
+
+	len = os_snprintf(buf, sizeof(buf), "CTRL-EVENT-BENCH seq=%u ts=%llu",
+			  seq, bench_now_ns());
+	os_snprintf(levelstr, sizeof(levelstr), "<%d>", MSG_INFO);
+	io[0].iov_base = levelstr;
+	io[0].iov_len = os_strlen(levelstr);
+	io[1].iov_base = buf;
+	io[1].iov_len = len;
+	os_memset(&msg, 0, sizeof(msg));
+	msg.msg_iov = io;
+	msg.msg_iovlen = 2;
+	msg.msg_name = dst;
+	msg.msg_namelen = sizeof(*dst);
+	if (sendmsg(sock, &msg, 0) < 0)
+		perror("sendmsg");
+}
+
+static int bench_ctrl(unsigned int events, unsigned int interval_us)
+{
+	struct sockaddr_un addr, from;
+	struct bench_result res;
+	struct pollfd pfd;
+	socklen_t fromlen;
+	unsigned long long cpu;
+	unsigned int i;
+	char buf[64];
+	int sock, pipe_fd, len, attached = 0;
+	pid_t pid;
+
+	os_memset(&addr, 0, sizeof(addr));
+	addr.sun_family = AF_UNIX;
+	os_strlcpy(addr.sun_path, BENCH_CTRL_PATH, sizeof(addr.sun_path));
+	sock = socket(PF_UNIX, SOCK_DGRAM, 0);
+	if (sock < 0)
+		return -1;
+	unlink(addr.sun_path);
+	if (bind(sock, (struct sockaddr *) &addr, sizeof(addr)) < 0) {
+		close(sock);
+		return -1;
+	}
+
+	pid = bench_fork(1, events, &pipe_fd);
+	if (pid < 0) {
+		close(sock);
+		return -1;
+	}
+	pfd.fd = sock;
+	pfd.events = POLLIN;
+	while (!attached && poll(&pfd, 1, 5000) > 0) {
+		fromlen = sizeof(from);
+		len = recvfrom(sock, buf, sizeof(buf) - 1, 0,
+			       (struct sockaddr *) &from, &fromlen);
+		if (len < 0)
+			continue;
+		buf[len] = '\0';
+		attached = os_strcmp(buf, "ATTACH") == 0;
+		sendto(sock, attached ? "OK\n" : "FAIL\n", attached ? 3 : 5, 0,
+		       (struct sockaddr *) &from, fromlen);
+	}
+
+	cpu = bench_cpu_ns();
+	for (i = 0; attached && i < events; i++) {
+		bench_ctrl_send(sock, &from, i);
+		usleep(interval_us);
+	}
+	cpu = bench_cpu_ns() - cpu;
+
+	close(sock);
+	unlink(addr.sun_path);
+	if (bench_collect(pid, pipe_fd, &res) < 0)
+		return -1;
+	bench_report("ctrl", events, cpu, &res);
+	return 0;
+}
+
+int main(int argc, char *argv[])
+{
+	unsigned int events = BENCH_EVENTS, interval_us = BENCH_INTERVAL_US;
+
+	if (argc > 1)
+		events = atoi(argv[1]);
+	if (argc > 2)
+		interval_us = atoi(argv[2]);
+	if (events == 0) {
+		fprintf(stderr, "usage: %s [events] [interval_us]\n", argv[0]);
+		return 1;
+	}
+
+	if (bench_ring(events, interval_us) < 0) {
+		fprintf(stderr, "event ring benchmark failed\n");
+		return 1;
+	}
+	if (bench_ctrl(events, interval_us) < 0) {
+		fprintf(stderr, "control interface benchmark failed\n");
+		return 1;
+	}
+	return 0;
+}
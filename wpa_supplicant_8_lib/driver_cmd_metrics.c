@@ -0,0 +1,329 @@
+/*
+ * Driver interaction for private interface - out-of-band metrics
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 2 as
+ * published by the Free Software Foundation.
+ *
+ * Alternatively, this software may be distributed under the terms of BSD
+ * license.
+ *
+ */
+
+#include "includes.h"
+#include <pthread.h>
+#include <signal.h>
+#include <sys/stat.h>
+#include <sys/un.h>
+
+#include "common.h"
+
+#include "driver_cmd_metrics.h"
+
+/*
+ * Metrics are updated by the eloop thread and served in OpenMetrics text
+ * format by a separate thread, so they stay available while the eloop thread
+ * is blocked in a driver ioctl. The values are protected by a sequence
+ * counter: the writer makes it odd while updating and the reader retries its
+ * copy until it saw the same even value before and after. Neither side ever
+ * waits for the other.
+ */
+struct metrics_values {
+	unsigned long long driver_cmds;
+	unsigned long long driver_cmd_errors;
+	unsigned long long ioctls;
+	unsigned long long ioctl_errors;
+	unsigned long long ioctl_buckets[METRICS_NUM_BUCKETS + 1];
+	unsigned long long ioctl_usec_sum;
+	unsigned long long hanged;
+	unsigned long long signal_polls;
+	/* Start of the ioctl in progress, 0 if none */
+	long long ioctl_start_usec;
+	int driver_started;
+	int bgscan_enabled;
+	int sequential_errors;
+	int rssi;
+	int txrate;
+};
+
+static const long long metrics_bucket_usec[METRICS_NUM_BUCKETS] = {
+	1000, 5000, 10000, 50000, 100000, 500000, 1000000, 5000000
+};
+
+static const char *metrics_bucket_le[METRICS_NUM_BUCKETS] = {
+	"0.001", "0.005", "0.01", "0.05", "0.1", "0.5", "1", "5"
+};
+
+static struct {
+	unsigned int seq;
+	struct metrics_values values;
+	int sock;
+	int initialized;
+} metrics;
+
+static long long metrics_now_usec(void)
+{
+	struct timespec ts;
+
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return (long long) ts.tv_sec * 1000000 + ts.tv_nsec / 1000;
+}
+
+static void metrics_write_begin(void)
+{
+	__atomic_store_n(&metrics.seq, metrics.seq + 1, __ATOMIC_RELAXED);
+	__atomic_thread_fence(__ATOMIC_RELEASE);
+}
+
+static void metrics_write_end(void)
+{
+	__atomic_store_n(&metrics.seq, metrics.seq + 1, __ATOMIC_RELEASE);
+}
+
+static int metrics_read(struct metrics_values *values)
+{
+	unsigned int seq, tries;
+
+	for (tries = 0; tries < 1000; tries++) {
+		seq = __atomic_load_n(&metrics.seq, __ATOMIC_ACQUIRE);
+		if (seq & 1)
+			continue;
+		os_memcpy(values, &metrics.values, sizeof(*values));
+		__atomic_thread_fence(__ATOMIC_ACQUIRE);
+		if (__atomic_load_n(&metrics.seq, __ATOMIC_RELAXED) == seq)
+			return 0;
+	}
+	return -1;
+}
+
+void wpa_driver_metrics_driver_cmd(int failed)
+{
+	metrics_write_begin();
+	metrics.values.driver_cmds++;
+	if (failed)
+		metrics.values.driver_cmd_errors++;
+	metrics_write_end();
+}
+
+void wpa_driver_metrics_ioctl_start(void)
+{
+	metrics_write_begin();
+	metrics.values.ioctl_start_usec = metrics_now_usec();
+	metrics_write_end();
+}
+
+void wpa_driver_metrics_ioctl_done(int ret)
+{
+	long long usec = metrics_now_usec() - metrics.values.ioctl_start_usec;
+	int i;
+
+	for (i = 0; i < METRICS_NUM_BUCKETS; i++) {
+		if (usec <= metrics_bucket_usec[i])
+			break;
+	}
+
+	metrics_write_begin();
+	metrics.values.ioctls++;
+	if (ret < 0)
+		metrics.values.ioctl_errors++;
+	metrics.values.ioctl_buckets[i]++;
+	metrics.values.ioctl_usec_sum += usec;
+	metrics.values.ioctl_start_usec = 0;
+	metrics_write_end();
+}
+
+void wpa_driver_metrics_hanged(void)
+{
+	metrics_write_begin();
+	metrics.values.hanged++;
+	metrics_write_end();
+}
+
+void wpa_driver_metrics_state(int started, int bgscan_enabled, int errors)
+{
+	metrics_write_begin();
+	metrics.values.driver_started = started;
+	metrics.values.bgscan_enabled = bgscan_enabled;
+	metrics.values.sequential_errors = errors;
+	metrics_write_end();
+}
+
+void wpa_driver_metrics_signal_poll(void)
+{
+	metrics_write_begin();
+	metrics.values.signal_polls++;
+	metrics_write_end();
+}
+
+void wpa_driver_metrics_signal(int rssi, int txrate)
+{
+	metrics_write_begin();
+	metrics.values.rssi = rssi;
+	metrics.values.txrate = txrate;
+	metrics_write_end();
+}
+
+static int metrics_format(char *buf, size_t buf_len)
+{
+	struct metrics_values v;
+	unsigned long long cumulative = 0;
+	long long inflight = 0;
+	char *pos = buf, *end = buf + buf_len;
+	int i, ret;
+
+	if (metrics_read(&v) < 0)
+		return os_snprintf(buf, buf_len, "# EOF\n");
+	if (v.ioctl_start_usec)
+		inflight = metrics_now_usec() - v.ioctl_start_usec;
+
+	ret = os_snprintf(pos, end - pos,
+			  "# TYPE wext_driver_cmds counter\n"
+			  "wext_driver_cmds_total %llu\n"
+			  "# TYPE wext_driver_cmd_errors counter\n"
+			  "wext_driver_cmd_errors_total %llu\n"
+			  "# TYPE wext_driver_hanged counter\n"
+			  "wext_driver_hanged_total %llu\n"
+			  "# TYPE wext_driver_signal_polls counter\n"
+			  "wext_driver_signal_polls_total %llu\n"
+			  "# TYPE wext_driver_ioctl_errors counter\n"
+			  "wext_driver_ioctl_errors_total %llu\n"
+			  "# TYPE wext_driver_ioctl_latency_seconds histogram\n"
+			  "# UNIT wext_driver_ioctl_latency_seconds seconds\n",
+			  v.driver_cmds, v.driver_cmd_errors, v.hanged,
+			  v.signal_polls, v.ioctl_errors);
+	if (ret < 0 || ret >= end - pos)
+		return -1;
+	pos += ret;
+
+	for (i = 0; i < METRICS_NUM_BUCKETS; i++) {
+		cumulative += v.ioctl_buckets[i];
+		ret = os_snprintf(pos, end - pos,
+				  "wext_driver_ioctl_latency_seconds_bucket"
+				  "{le=\"%s\"} %llu\n",
+				  metrics_bucket_le[i], cumulative);
+		if (ret < 0 || ret >= end - pos)
+			return -1;
+		pos += ret;
+	}
+
+	ret = os_snprintf(pos, end - pos,
+			  "wext_driver_ioctl_latency_seconds_bucket"
+			  "{le=\"+Inf\"} %llu\n"
+			  "wext_driver_ioctl_latency_seconds_sum %llu.%06llu\n"
+			  "wext_driver_ioctl_latency_seconds_count %llu\n"
+			  "# TYPE wext_driver_ioctl_inflight_seconds gauge\n"
+			  "# UNIT wext_driver_ioctl_inflight_seconds seconds\n"
+			  "wext_driver_ioctl_inflight_seconds %lld.%06lld\n"
+			  "# TYPE wext_driver_started gauge\n"
+			  "wext_driver_started %d\n"
+			  "# TYPE wext_driver_bgscan_enabled gauge\n"
+			  "wext_driver_bgscan_enabled %d\n"
+			  "# TYPE wext_driver_sequential_errors gauge\n"
+			  "wext_driver_sequential_errors %d\n"
+			  "# TYPE wext_driver_rssi_dbm gauge\n"
+			  "wext_driver_rssi_dbm %d\n"
+			  "# TYPE wext_driver_txrate_kbps gauge\n"
+			  "wext_driver_txrate_kbps %d\n"
+			  "# EOF\n",
+			  v.ioctls, v.ioctl_usec_sum / 1000000,
+			  v.ioctl_usec_sum % 1000000, v.ioctls,
+			  inflight / 1000000, inflight % 1000000,
+			  v.driver_started, v.bgscan_enabled,
+			  v.sequential_errors, v.rssi, v.txrate);
+	if (ret < 0 || ret >= end - pos)
+		return -1;
+	pos += ret;
+	return pos - buf;
+}
+
+static void * metrics_thread(void *arg)
+{
+	char buf[METRICS_BUF_SIZE];
+	struct timeval tv;
+	int fd, len, ret, sent;
+
+	for (;;) {
+		fd = accept(metrics.sock, NULL, NULL);
+		if (fd < 0) {
+			if (errno != EINTR)
+				sleep(1);
+			continue;
+		}
+		/* A stuck client must not keep others from scraping */
+		tv.tv_sec = 1;
+		tv.tv_usec = 0;
+		setsockopt(fd, SOL_SOCKET, SO_SNDTIMEO, &tv, sizeof(tv));
+
+		len = metrics_format(buf, sizeof(buf));
+		for (sent = 0; len > 0 && sent < len; sent += ret) {
+			ret = send(fd, buf + sent, len - sent, MSG_NOSIGNAL);
+			if (ret <= 0)
+				break;
+		}
+		close(fd);
+	}
+	return NULL;
+}
+
+/**
+ * wpa_driver_metrics_init - Start serving metrics
+ * @ifname: Interface name used in the socket name
+ * Returns: 0 on success, -1 on failure
+ *
+ * Creates the listening socket and the thread serving it. Only the first
+ * call does anything.
+ */
+int wpa_driver_metrics_init(const char *ifname)
+{
+	struct sockaddr_un addr;
+	pthread_attr_t attr;
+	pthread_t thread;
+	sigset_t set, oldset;
+	int ret;
+
+	if (metrics.initialized)
+		return 0;
+	/* Do not retry on every driver command if this fails */
+	metrics.initialized = 1;
+
+	os_memset(&addr, 0, sizeof(addr));
+	addr.sun_family = AF_UNIX;
+	os_snprintf(addr.sun_path, sizeof(addr.sun_path), "%s/%s%s",
+		    METRICS_SOCKET_DIR, METRICS_SOCKET_PREFIX, ifname);
+
+	metrics.sock = socket(PF_UNIX, SOCK_STREAM, 0);
+	if (metrics.sock < 0) {
+		wpa_printf(MSG_ERROR, "%s: socket: %s", __func__,
+			   strerror(errno));
+		return -1;
+	}
+	unlink(addr.sun_path);
+	if (bind(metrics.sock, (struct sockaddr *) &addr, sizeof(addr)) < 0 ||
+	    chmod(addr.sun_path, S_IRWXU | S_IRWXG) < 0 ||
+	    listen(metrics.sock, 4) < 0) {
+		wpa_printf(MSG_ERROR, "%s: %s: %s", __func__, addr.sun_path,
+			   strerror(errno));
+		close(metrics.sock);
+		return -1;
+	}
+
+	/* Leave signal handling to the eloop thread */
+	sigfillset(&set);
+	pthread_sigmask(SIG_SETMASK, &set, &oldset);
+	pthread_attr_init(&attr);
+	pthread_attr_setdetachstate(&attr, PTHREAD_CREATE_DETACHED);
+	ret = pthread_create(&thread, &attr, metrics_thread, NULL);
+	pthread_attr_destroy(&attr);
+	pthread_sigmask(SIG_SETMASK, &oldset, NULL);
+	if (ret != 0) {
+		wpa_printf(MSG_ERROR, "%s: pthread_create: %s", __func__,
+			   strerror(ret));
+		close(metrics.sock);
+		unlink(addr.sun_path);
+		return -1;
+	}
+
+	wpa_printf(MSG_DEBUG, "%s: serving metrics on %s", __func__,
+		   addr.sun_path);
+	return 0;
+}
@@ -0,0 +1,31 @@
+/*
+ * Driver interaction for private interface - out-of-band metrics
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 2 as
+ * published by the Free Software Foundation.
+ *
+ * Alternatively, this software may be distributed under the terms of BSD
+ * license.
+ *
+ */
+#ifndef DRIVER_CMD_METRICS_H
+#define DRIVER_CMD_METRICS_H
+
+/* Metrics are served on METRICS_SOCKET_DIR/METRICS_SOCKET_PREFIX<ifname> */
+#define METRICS_SOCKET_DIR		"/data/misc/wifi/sockets"
+#define METRICS_SOCKET_PREFIX		"metrics-"
+#define METRICS_BUF_SIZE		4096
+/* Number of ioctl latency histogram buckets, excluding +Inf */
+#define METRICS_NUM_BUCKETS		8
+
+int wpa_driver_metrics_init(const char *ifname);
+void wpa_driver_metrics_driver_cmd(int failed);
+void wpa_driver_metrics_ioctl_start(void);
+void wpa_driver_metrics_ioctl_done(int ret);
+void wpa_driver_metrics_hanged(void);
+void wpa_driver_metrics_state(int started, int bgscan_enabled, int errors);
+void wpa_driver_metrics_signal_poll(void);
+void wpa_driver_metrics_signal(int rssi, int txrate);
+
+#endif /* DRIVER_CMD_METRICS_H */
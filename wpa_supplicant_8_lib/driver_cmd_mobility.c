@@ -0,0 +1,228 @@
+/*
+ * Driver interaction for private interface - mobility detection
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 2 as
+ * published by the Free Software Foundation.
+ *
+ * Alternatively, this software may be distributed under the terms of BSD
+ * license.
+ *
+ */
+
+#include "includes.h"
+
+#include "common.h"
+#include "wpa_supplicant_i.h"
+#include "bss.h"
+
+#include "driver_cmd_mobility.h"
+
+/*
+ * Consecutive scan results are compared with a weighted Jaccard index over
+ * the BSSIDs: every BSS seen in either scan has weight 1 in the union and a
+ * BSS seen in both scans adds 1 - |RSSI change| / MOBILITY_RSSI_SCALE to the
+ * intersection. A stationary device sees the same BSSes at the same levels
+ * (index close to 1), a walking one loses and gains some BSSes and a
+ * vehicular one sees an almost entirely new set on every scan. With at most
+ * MOBILITY_MAX_BSS BSSes per scan the exact index is cheap to compute.
+ *
+ * Many scans only cover some channels (bgscan, connection attempts, scans
+ * for a predicted network), so only BSSes on frequencies seen in both scans
+ * are compared, and scans seeing fewer than MOBILITY_MIN_CHANNELS frequencies
+ * are ignored.
+ */
+struct mobility_bss {
+	u8 bssid[ETH_ALEN];
+	int freq;
+	int level;
+};
+
+struct mobility_scan {
+	struct mobility_bss bss[MOBILITY_MAX_BSS];
+	size_t num;
+	int freqs[MOBILITY_MAX_BSS];
+	size_t num_freqs;
+};
+
+static const char *mobility_names[] = {
+	"unknown", "stationary", "walking", "vehicular"
+};
+
+static struct {
+	struct mobility_scan prev;
+	struct os_time prev_time;
+	int have_prev;
+	/* Smoothed dissimilarity in permille */
+	int dissimilarity;
+	/* Dissimilarity of the last comparison in permille */
+	int last;
+	unsigned int samples;
+	enum mobility_state state;
+} mobility;
+
+static int mobility_has_freq(const struct mobility_scan *scan, int freq)
+{
+	size_t i;
+
+	for (i = 0; i < scan->num_freqs; i++) {
+		if (scan->freqs[i] == freq)
+			return 1;
+	}
+	return 0;
+}
+
+static int mobility_compare(const struct mobility_scan *cur)
+{
+	const struct mobility_scan *prev = &mobility.prev;
+	size_t i, j, num_union = 0;
+	int inter = 0, diff;
+
+	for (j = 0; j < prev->num; j++) {
+		if (mobility_has_freq(cur, prev->bss[j].freq))
+			num_union++;
+	}
+	for (i = 0; i < cur->num; i++) {
+		if (!mobility_has_freq(prev, cur->bss[i].freq))
+			continue;
+		for (j = 0; j < prev->num; j++) {
+			if (os_memcmp(cur->bss[i].bssid, prev->bss[j].bssid,
+				      ETH_ALEN) == 0)
+				break;
+		}
+		if (j == prev->num) {
+			num_union++;
+			continue;
+		}
+		diff = cur->bss[i].level - prev->bss[j].level;
+		if (diff < 0)
+			diff = -diff;
+		if (diff < MOBILITY_RSSI_SCALE)
+			inter += 1000 - diff * 1000 / MOBILITY_RSSI_SCALE;
+	}
+
+	if (num_union == 0)
+		return -1;
+	return 1000 - inter / (int) num_union;
+}
+
+static enum mobility_state mobility_classify(int dissimilarity)
+{
+	if (dissimilarity >= MOBILITY_VEHICULAR_THRESHOLD)
+		return MOBILITY_VEHICULAR;
+	if (dissimilarity >= MOBILITY_WALKING_THRESHOLD)
+		return MOBILITY_WALKING;
+	return MOBILITY_STATIONARY;
+}
+
+/**
+ * wpa_driver_mobility_update - Update the mobility state from new scan results
+ * @wpa_s: Pointer to wpa_supplicant data
+ * Returns: 1 if the mobility state changed, 0 otherwise
+ */
+int wpa_driver_mobility_update(struct wpa_supplicant *wpa_s)
+{
+	struct mobility_scan cur;
+	struct mobility_bss *m;
+	struct wpa_bss *bss;
+	struct os_time now;
+	enum mobility_state state;
+	int d;
+
+	/* Only the BSSes seen by the last scan, not older table entries */
+	cur.num = 0;
+	cur.num_freqs = 0;
+	dl_list_for_each(bss, &wpa_s->bss, struct wpa_bss, list) {
+		if (cur.num >= MOBILITY_MAX_BSS)
+			break;
+		if (bss->last_update_idx != wpa_s->bss_update_idx)
+			continue;
+		/* Weak BSSes still show that their channel was scanned */
+		if (cur.num_freqs < ARRAY_SIZE(cur.freqs) &&
+		    !mobility_has_freq(&cur, bss->freq))
+			cur.freqs[cur.num_freqs++] = bss->freq;
+		if (bss->level < MOBILITY_MIN_LEVEL)
+			continue;
+		m = &cur.bss[cur.num++];
+		os_memcpy(m->bssid, bss->bssid, ETH_ALEN);
+		m->freq = bss->freq;
+		m->level = bss->level;
+	}
+	if (cur.num_freqs < MOBILITY_MIN_CHANNELS)
+		return 0;
+	os_get_time(&now);
+
+	if (mobility.have_prev &&
+	    now.sec - mobility.prev_time.sec <= MOBILITY_MAX_INTERVAL &&
+	    (d = mobility_compare(&cur)) >= 0) {
+		mobility.last = d;
+		if (mobility.samples++ == 0)
+			mobility.dissimilarity = d;
+		else
+			mobility.dissimilarity = (mobility.dissimilarity + d) / 2;
+	}
+
+	os_memcpy(&mobility.prev, &cur, sizeof(cur));
+	mobility.prev_time = now;
+	mobility.have_prev = 1;
+
+	if (mobility.samples < 2)
+		return 0;
+	state = mobility_classify(mobility.dissimilarity);
+	if (state == mobility.state)
+		return 0;
+	wpa_printf(MSG_DEBUG, "%s: %s -> %s (dissimilarity %d)", __func__,
+		   mobility_names[mobility.state], mobility_names[state],
+		   mobility.dissimilarity);
+	mobility.state = state;
+	return 1;
+}
+
+enum mobility_state wpa_driver_mobility_state(void)
+{
+	return mobility.state;
+}
+
+/**
+ * wpa_driver_mobility_scan_interval - Adapt a scan interval to mobility
+ * @interval: Scan interval in seconds for an unknown mobility state
+ * @min_interval: Smallest interval that can be used
+ * @max_interval: Largest interval that can be used
+ * Returns: Scan interval to use
+ *
+ * Stationary devices scan MOBILITY_STATIONARY_FACTOR times less often and
+ * vehicular ones MOBILITY_VEHICULAR_DIVISOR times more often.
+ */
+int wpa_driver_mobility_scan_interval(int interval, int min_interval,
+				      int max_interval)
+{
+	switch (mobility.state) {
+	case MOBILITY_STATIONARY:
+		interval *= MOBILITY_STATIONARY_FACTOR;
+		break;
+	case MOBILITY_VEHICULAR:
+		interval /= MOBILITY_VEHICULAR_DIVISOR;
+		break;
+	default:
+		break;
+	}
+	if (interval > max_interval)
+		interval = max_interval;
+	if (interval < min_interval)
+		interval = min_interval;
+	return interval;
+}
+
+/**
+ * wpa_driver_mobility_cmd - Handle MOBILITY driver command
+ * @buf: Buffer for the reply
+ * @buf_len: Length of the reply buffer
+ * Returns: Length of the reply on success, -1 on failure
+ */
+int wpa_driver_mobility_cmd(char *buf, size_t buf_len)
+{
+	return os_snprintf(buf, buf_len, "state=%s dissimilarity=%d last=%d "
+			   "samples=%u\n", mobility_names[mobility.state],
+			   mobility.dissimilarity, mobility.last,
+			   mobility.samples);
+}
@@ -0,0 +1,49 @@
+/*
+ * Driver interaction for private interface - mobility detection
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 2 as
+ * published by the Free Software Foundation.
+ *
+ * Alternatively, this software may be distributed under the terms of BSD
+ * license.
+ *
+ */
+#ifndef DRIVER_CMD_MOBILITY_H
+#define DRIVER_CMD_MOBILITY_H
+
+#define MOBILITY_CMD			"MOBILITY"
+
+/* Number of BSSes of a scan compared with the previous scan */
+#define MOBILITY_MAX_BSS		64
+/* BSSes weaker than this come and go even when not moving */
+#define MOBILITY_MIN_LEVEL		-88
+/* RSSI change (dB) at which a BSS seen in both scans counts as changed */
+#define MOBILITY_RSSI_SCALE		20
+/* Scans seeing fewer frequencies than this are not compared */
+#define MOBILITY_MIN_CHANNELS		3
+/* Scans further apart than this (seconds) are not compared */
+#define MOBILITY_MAX_INTERVAL		600
+/* Thresholds (permille) on the smoothed scan-to-scan dissimilarity */
+#define MOBILITY_WALKING_THRESHOLD	250
+#define MOBILITY_VEHICULAR_THRESHOLD	700
+/* Scan interval scaling */
+#define MOBILITY_STATIONARY_FACTOR	4
+#define MOBILITY_VEHICULAR_DIVISOR	2
+
+enum mobility_state {
+	MOBILITY_UNKNOWN,
+	MOBILITY_STATIONARY,
+	MOBILITY_WALKING,
+	MOBILITY_VEHICULAR
+};
+
+struct wpa_supplicant;
+
+int wpa_driver_mobility_update(struct wpa_supplicant *wpa_s);
+enum mobility_state wpa_driver_mobility_state(void);
+int wpa_driver_mobility_scan_interval(int interval, int min_interval,
+				      int max_interval);
+int wpa_driver_mobility_cmd(char *buf, size_t buf_len);
+
+#endif /* DRIVER_CMD_MOBILITY_H */
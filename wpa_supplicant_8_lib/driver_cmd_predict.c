@@ -0,0 +1,320 @@
+/*
+ * Driver interaction for private interface - known network prediction
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 2 as
+ * published by the Free Software Foundation.
+ *
+ * Alternatively, this software may be distributed under the terms of BSD
+ * license.
+ *
+ */
+
+#include "includes.h"
+
+#include "common.h"
+#include "wpa_supplicant_i.h"
+#include "config.h"
+#include "bss.h"
+
+#include "driver_cmd_wext.h"
+#include "driver_cmd_predict.h"
+
+/*
+ * A fingerprint is the set of hashed BSSIDs of the PREDICT_TOP_K strongest
+ * BSSes of a scan. The cache maps the fingerprint of the last scan before a
+ * connection to the network and frequency that were connected to. When a
+ * later scan, while not connected, shares at least PREDICT_MIN_MATCH hashes
+ * with a cached fingerprint, the network is predicted and only its channel
+ * needs to be scanned.
+ */
+struct predict_fingerprint {
+	u32 hash[PREDICT_TOP_K];
+	int num;
+};
+
+struct predict_entry {
+	struct predict_fingerprint fp;
+	int id;
+	u8 ssid[32];
+	size_t ssid_len;
+	int freq;
+	os_time_t last_used;
+};
+
+static struct {
+	struct predict_entry cache[PREDICT_CACHE_SIZE];
+	int num_cache;
+	/* Fingerprint of the last scan */
+	struct predict_fingerprint last_fp;
+	int connected;
+	/* Prediction whose scan has not been started yet */
+	struct predict_entry *candidate;
+	/* Scan for a prediction requested, its results are not fingerprinted */
+	int targeted_scan;
+	/* Prediction waiting for a connection */
+	struct predict_entry *pending;
+	struct os_time pending_time;
+	unsigned int predictions;
+	unsigned int hits;
+	unsigned int misses;
+	unsigned long long hit_connect_ms;
+} predict;
+
+static u32 predict_hash(const u8 *bssid)
+{
+	u32 hash = 2166136261U;
+	int i;
+
+	for (i = 0; i < ETH_ALEN; i++) {
+		hash ^= bssid[i];
+		hash *= 16777619;
+	}
+	return hash;
+}
+
+static void predict_fingerprint(struct wpa_supplicant *wpa_s,
+				struct predict_fingerprint *fp)
+{
+	int level[PREDICT_TOP_K];
+	struct wpa_bss *bss;
+	int i;
+
+	fp->num = 0;
+	dl_list_for_each(bss, &wpa_s->bss, struct wpa_bss, list) {
+		if (bss->last_update_idx != wpa_s->bss_update_idx)
+			continue;
+		/* Insertion into the top-K list sorted by level */
+		for (i = fp->num; i > 0 && level[i - 1] < bss->level; i--) {
+			if (i < PREDICT_TOP_K) {
+				level[i] = level[i - 1];
+				fp->hash[i] = fp->hash[i - 1];
+			}
+		}
+		if (i >= PREDICT_TOP_K)
+			continue;
+		level[i] = bss->level;
+		fp->hash[i] = predict_hash(bss->bssid);
+		if (fp->num < PREDICT_TOP_K)
+			fp->num++;
+	}
+}
+
+static int predict_match(const struct predict_fingerprint *a,
+			 const struct predict_fingerprint *b)
+{
+	int i, j, match = 0;
+
+	for (i = 0; i < a->num; i++) {
+		for (j = 0; j < b->num; j++) {
+			if (a->hash[i] == b->hash[j]) {
+				match++;
+				break;
+			}
+		}
+	}
+	return match;
+}
+
+static struct wpa_ssid * predict_network(struct wpa_supplicant *wpa_s,
+					 const struct predict_entry *e)
+{
+	struct wpa_ssid *ssid;
+
+	for (ssid = wpa_s->conf->ssid; ssid; ssid = ssid->next) {
+		if (ssid->id == e->id && ssid->ssid_len == e->ssid_len &&
+		    os_memcmp(ssid->ssid, e->ssid, e->ssid_len) == 0)
+			return ssid->disabled ? NULL : ssid;
+	}
+	return NULL;
+}
+
+static void predict_expire(void)
+{
+	struct os_time now;
+
+	if (predict.pending == NULL)
+		return;
+	os_get_time(&now);
+	if (now.sec - predict.pending_time.sec > PREDICT_WINDOW) {
+		predict.pending = NULL;
+		predict.misses++;
+	}
+}
+
+/**
+ * wpa_driver_predict_scan_results - Look up new scan results in the cache
+ * @wpa_s: Pointer to wpa_supplicant data
+ * @target: Filled in with the predicted network
+ * Returns: 1 if a network was predicted and should be scanned for, else 0
+ *
+ * The prediction only counts once wpa_driver_predict_scan_started() reports
+ * that the scan for it was requested. The results of that scan only cover
+ * one channel, so they neither replace the fingerprint learnt on connection
+ * nor lead to another prediction.
+ */
+int wpa_driver_predict_scan_results(struct wpa_supplicant *wpa_s,
+				    struct predict_target *target)
+{
+	struct predict_entry *e, *best = NULL;
+	int i, match, best_match = PREDICT_MIN_MATCH - 1;
+
+	predict_expire();
+	if (predict.targeted_scan) {
+		predict.targeted_scan = 0;
+		return 0;
+	}
+	predict_fingerprint(wpa_s, &predict.last_fp);
+
+	if (wpa_s->wpa_state > WPA_SCANNING || predict.pending ||
+	    wpa_s->conf == NULL)
+		return 0;
+
+	predict.candidate = NULL;
+	for (i = 0; i < predict.num_cache; i++) {
+		e = &predict.cache[i];
+		match = predict_match(&predict.last_fp, &e->fp);
+		if (match > best_match && predict_network(wpa_s, e)) {
+			best = e;
+			best_match = match;
+		}
+	}
+	if (best == NULL)
+		return 0;
+
+	predict.candidate = best;
+	os_memcpy(target->ssid, best->ssid, best->ssid_len);
+	target->ssid_len = best->ssid_len;
+	target->freq = best->freq;
+	wpa_printf(MSG_DEBUG, "%s: predicted %s on %d MHz (%d/%d BSSes)",
+		   __func__, wpa_ssid_txt(best->ssid, best->ssid_len),
+		   best->freq, best_match, predict.last_fp.num);
+	return 1;
+}
+
+/**
+ * wpa_driver_predict_scan_started - Start scoring the predicted network
+ *
+ * Called when the scan for the network returned by
+ * wpa_driver_predict_scan_results() was successfully requested. A connection
+ * to it within PREDICT_WINDOW seconds counts as a hit.
+ */
+void wpa_driver_predict_scan_started(void)
+{
+	if (predict.candidate == NULL)
+		return;
+	predict.predictions++;
+	predict.pending = predict.candidate;
+	predict.candidate = NULL;
+	predict.targeted_scan = 1;
+	os_get_time(&predict.pending_time);
+	predict.pending->last_used = predict.pending_time.sec;
+}
+
+static void predict_learn(struct wpa_supplicant *wpa_s, os_time_t now)
+{
+	struct wpa_ssid *ssid = wpa_s->current_ssid;
+	struct predict_entry *e = NULL;
+	int i;
+
+	if (predict.last_fp.num < PREDICT_MIN_MATCH ||
+	    ssid->ssid_len > sizeof(e->ssid))
+		return;
+
+	/* Update a matching entry, else replace the least recently used */
+	for (i = 0; i < predict.num_cache; i++) {
+		if (predict_match(&predict.last_fp, &predict.cache[i].fp) ==
+		    predict.last_fp.num) {
+			e = &predict.cache[i];
+			break;
+		}
+	}
+	if (e == NULL && predict.num_cache < PREDICT_CACHE_SIZE)
+		e = &predict.cache[predict.num_cache++];
+	if (e == NULL) {
+		e = &predict.cache[0];
+		for (i = 1; i < predict.num_cache; i++) {
+			if (predict.cache[i].last_used < e->last_used)
+				e = &predict.cache[i];
+		}
+	}
+
+	os_memcpy(&e->fp, &predict.last_fp, sizeof(e->fp));
+	e->id = ssid->id;
+	os_memcpy(e->ssid, ssid->ssid, ssid->ssid_len);
+	e->ssid_len = ssid->ssid_len;
+	e->freq = wpa_s->current_bss->freq;
+	e->last_used = now;
+}
+
+/**
+ * wpa_driver_predict_link_check - Learn from and score new connections
+ * @wpa_s: Pointer to wpa_supplicant data
+ */
+void wpa_driver_predict_link_check(struct wpa_supplicant *wpa_s)
+{
+	struct os_time now, diff;
+	struct predict_entry *e;
+
+	if (wpa_s->wpa_state != WPA_COMPLETED) {
+		predict.connected = 0;
+		return;
+	}
+	if (predict.connected || wpa_s->current_ssid == NULL ||
+	    wpa_s->current_bss == NULL)
+		return;
+	predict.connected = 1;
+	predict.candidate = NULL;
+
+	predict_expire();
+	os_get_time(&now);
+	e = predict.pending;
+	if (e) {
+		predict.pending = NULL;
+		if (e->id == wpa_s->current_ssid->id) {
+			os_time_sub(&now, &predict.pending_time, &diff);
+			predict.hits++;
+			predict.hit_connect_ms += diff.sec * 1000 +
+				diff.usec / 1000;
+		} else {
+			predict.misses++;
+		}
+	}
+	predict_learn(wpa_s, now.sec);
+}
+
+/**
+ * wpa_driver_predict_cmd - Handle PREDICT driver commands
+ * @cmd: Driver command, PREDICT or PREDICT-FLUSH
+ * @buf: Buffer for the reply
+ * @buf_len: Length of the reply buffer
+ * @num_channels: Number of channels of a full scan
+ * Returns: Length of the reply on success, -1 on failure
+ *
+ * The saved latency is estimated as the dwell time of the channels a full
+ * scan would have visited in addition to the predicted one.
+ */
+int wpa_driver_predict_cmd(char *cmd, char *buf, size_t buf_len,
+			   int num_channels)
+{
+	unsigned int scored;
+
+	if (os_strcasecmp(cmd, PREDICT_FLUSH_CMD) == 0) {
+		predict.num_cache = 0;
+		predict.pending = NULL;
+		predict.candidate = NULL;
+		predict.targeted_scan = 0;
+		return os_snprintf(buf, buf_len, "OK\n");
+	}
+
+	predict_expire();
+	scored = predict.hits + predict.misses;
+	return os_snprintf(buf, buf_len, "entries=%d predictions=%u hits=%u "
+			   "misses=%u hit_rate=%u avg_connect_ms=%llu "
+			   "saved_ms=%llu\n", predict.num_cache,
+			   predict.predictions, predict.hits, predict.misses,
+			   scored ? predict.hits * 1000 / scored : 0,
+			   predict.hits ? predict.hit_connect_ms / predict.hits :
+			   0, (unsigned long long) predict.hits *
+			   (num_channels - 1) * WEXT_CSCAN_PASV_DWELL_TIME);
+}
@@ -0,0 +1,45 @@
+/*
+ * Driver interaction for private interface - known network prediction
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 2 as
+ * published by the Free Software Foundation.
+ *
+ * Alternatively, this software may be distributed under the terms of BSD
+ * license.
+ *
+ */
+#ifndef DRIVER_CMD_PREDICT_H
+#define DRIVER_CMD_PREDICT_H
+
+#define PREDICT_CMD			"PREDICT"
+#define PREDICT_CMD_SIZE		7
+#define PREDICT_FLUSH_CMD		"PREDICT-FLUSH"
+
+/* Number of strongest BSSes making up a fingerprint */
+#define PREDICT_TOP_K			4
+/* Number of fingerprint BSSes that must match for a prediction */
+#define PREDICT_MIN_MATCH		2
+#define PREDICT_CACHE_SIZE		16
+/* Time (seconds) a prediction has to result in a connection */
+#define PREDICT_WINDOW			30
+/* Retries of the scan for a prediction while another scan is running */
+#define PREDICT_SCAN_RETRIES		20
+#define PREDICT_SCAN_RETRY_US		250000
+
+struct wpa_supplicant;
+
+struct predict_target {
+	u8 ssid[32];
+	size_t ssid_len;
+	int freq;
+};
+
+int wpa_driver_predict_scan_results(struct wpa_supplicant *wpa_s,
+				    struct predict_target *target);
+void wpa_driver_predict_scan_started(void);
+void wpa_driver_predict_link_check(struct wpa_supplicant *wpa_s);
+int wpa_driver_predict_cmd(char *cmd, char *buf, size_t buf_len,
+			   int num_channels);
+
+#endif /* DRIVER_CMD_PREDICT_H */
@@ -0,0 +1,215 @@
+/*
+ * Driver interaction for private interface - board timing profile
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 2 as
+ * published by the Free Software Foundation.
+ *
+ * Alternatively, this software may be distributed under the terms of BSD
+ * license.
+ *
+ */
+
+#include "includes.h"
+#include <stddef.h>
+
+#include "common.h"
+
+#include "driver_cmd_wext.h"
+#include "driver_cmd_common.h"
+#include "driver_cmd_profile.h"
+
+struct profile_field {
+	const char *name;
+	size_t offset;
+	int min;
+	int max;
+};
+
+#define PROFILE_FIELD(f, min, max) \
+	{ #f, offsetof(struct driver_profile, f), (min), (max) }
+
+/*
+ * Bounds keep a bad profile from stalling scans or flooding the firmware. The
+ * PNO values must also fill, and fit, the hex digits of their PNOSETUP
+ * sections.
+ */
+static const struct profile_field profile_fields[] = {
+	PROFILE_FIELD(scan_timeout, 1, 60),
+	PROFILE_FIELD(scan_timeout_events, 1, 120),
+	PROFILE_FIELD(cscan_pasv_dwell, 10, 1000),
+	PROFILE_FIELD(cscan_pasv_dwell_max, 10, 10000),
+	PROFILE_FIELD(cscan_home_dwell, 10, 1000),
+	PROFILE_FIELD(pno_interval, WEXT_PNO_SCAN_INTERVAL_MIN,
+		      WEXT_PNO_SCAN_INTERVAL_MAX),
+	PROFILE_FIELD(pno_repeat, 1, 0xf),
+	PROFILE_FIELD(pno_max_repeat, 0, 0xf),
+	PROFILE_FIELD(sequential_errors, 1, 100),
+};
+
+static const struct driver_profile profile_defaults = {
+	.scan_timeout = 10,
+	.scan_timeout_events = 30,
+	.cscan_pasv_dwell = WEXT_CSCAN_PASV_DWELL_TIME_DEF,
+	.cscan_pasv_dwell_max = WEXT_CSCAN_PASV_DWELL_TIME_MAX,
+	.cscan_home_dwell = WEXT_CSCAN_HOME_DWELL_TIME,
+	.pno_interval = WEXT_PNO_SCAN_INTERVAL,
+	.pno_repeat = WEXT_PNO_REPEAT,
+	.pno_max_repeat = WEXT_PNO_MAX_REPEAT,
+	.sequential_errors = DRV_NUMBER_SEQUENTIAL_ERRORS,
+};
+
+static struct driver_profile profile_active = profile_defaults;
+static char profile_source[64] = "defaults";
+static int profile_loaded;
+
+static int * profile_value(struct driver_profile *p,
+			   const struct profile_field *field)
+{
+	return (int *) ((u8 *) p + field->offset);
+}
+
+static int profile_set(struct driver_profile *p, const char *name,
+		       const char *value)
+{
+	const struct profile_field *field;
+	unsigned int i;
+	char *end;
+	long val;
+
+	for (i = 0; i < ARRAY_SIZE(profile_fields); i++) {
+		field = &profile_fields[i];
+		if (os_strcmp(name, field->name) != 0)
+			continue;
+		val = strtol(value, &end, 0);
+		if (end == value || *end != '\0' || val < field->min ||
+		    val > field->max) {
+			wpa_printf(MSG_ERROR, "%s: %s=%s not in [%d, %d]",
+				   __func__, name, value, field->min,
+				   field->max);
+			return -1;
+		}
+		*profile_value(p, field) = val;
+		return 0;
+	}
+	wpa_printf(MSG_ERROR, "%s: unknown key '%s'", __func__, name);
+	return -1;
+}
+
+static int profile_parse(FILE *f, const char *fname, struct driver_profile *p)
+{
+	char buf[PROFILE_MAX_LINE], *pos, *value;
+	int line = 0, errors = 0;
+
+	while (fgets(buf, sizeof(buf), f)) {
+		line++;
+		pos = buf;
+		while (*pos == ' ' || *pos == '\t')
+			pos++;
+		if (*pos == '#' || *pos == '\n' || *pos == '\r' ||
+		    *pos == '\0')
+			continue;
+		value = pos + strcspn(pos, " \t\r\n");
+		*value = '\0';
+		value = os_strchr(pos, '=');
+		if (value == NULL) {
+			wpa_printf(MSG_ERROR, "%s:%d: invalid line '%s'",
+				   fname, line, pos);
+			errors++;
+			continue;
+		}
+		*value++ = '\0';
+		if (profile_set(p, pos, value) < 0)
+			errors++;
+	}
+
+	if (p->cscan_pasv_dwell > p->cscan_pasv_dwell_max) {
+		wpa_printf(MSG_ERROR, "%s: cscan_pasv_dwell %d exceeds "
+			   "cscan_pasv_dwell_max %d", fname,
+			   p->cscan_pasv_dwell, p->cscan_pasv_dwell_max);
+		errors++;
+	}
+	return errors ? -1 : 0;
+}
+
+/**
+ * wpa_driver_profile_load - Load the timing profile of the board
+ * Returns: 0 if a profile was loaded, -1 if the defaults are used
+ *
+ * Keys missing from the profile keep their default value. A profile with any
+ * invalid line is rejected as a whole, so values tuned together are never
+ * applied only in part. The profile is loaded on first use and reloaded
+ * with this function when the driver is started.
+ */
+int wpa_driver_profile_load(void)
+{
+	static const char *files[] = { PROFILE_FILE_DATA, PROFILE_FILE_SYSTEM };
+	struct driver_profile p;
+	unsigned int i;
+	FILE *f = NULL;
+	int ret;
+
+	for (i = 0; i < ARRAY_SIZE(files); i++) {
+		f = fopen(files[i], "r");
+		if (f)
+			break;
+	}
+
+	profile_loaded = 1;
+	profile_active = profile_defaults;
+	os_strlcpy(profile_source, "defaults", sizeof(profile_source));
+	if (f == NULL)
+		return -1;
+
+	p = profile_defaults;
+	ret = profile_parse(f, files[i], &p);
+	fclose(f);
+	if (ret < 0) {
+		wpa_printf(MSG_ERROR, "%s: ignoring %s, using defaults",
+			   __func__, files[i]);
+		return -1;
+	}
+
+	profile_active = p;
+	os_strlcpy(profile_source, files[i], sizeof(profile_source));
+	wpa_printf(MSG_DEBUG, "%s: loaded %s", __func__, files[i]);
+	return 0;
+}
+
+const struct driver_profile * wpa_driver_profile_get(void)
+{
+	/* The driver is started at init, without a START command */
+	if (!profile_loaded)
+		wpa_driver_profile_load();
+	return &profile_active;
+}
+
+/**
+ * wpa_driver_profile_cmd - Handle PROFILE driver command
+ * @buf: Buffer for the reply
+ * @buf_len: Length of the reply buffer
+ * Returns: Length of the reply on success, -1 on failure
+ */
+int wpa_driver_profile_cmd(char *buf, size_t buf_len)
+{
+	char *pos = buf, *end = buf + buf_len;
+	unsigned int i;
+	int ret;
+
+	wpa_driver_profile_get();
+	ret = os_snprintf(pos, end - pos, "source=%s\n", profile_source);
+	if (ret < 0 || ret >= end - pos)
+		return -1;
+	pos += ret;
+
+	for (i = 0; i < ARRAY_SIZE(profile_fields); i++) {
+		ret = os_snprintf(pos, end - pos, "%s=%d\n",
+				  profile_fields[i].name,
+				  *profile_value(&profile_active,
+						 &profile_fields[i]));
+		if (ret < 0 || ret >= end - pos)
+			return -1;
+		pos += ret;
+	}
+	return pos - buf;
+}
@@ -0,0 +1,45 @@
+/*
+ * Driver interaction for private interface - board timing profile
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 2 as
+ * published by the Free Software Foundation.
+ *
+ * Alternatively, this software may be distributed under the terms of BSD
+ * license.
+ *
+ */
+#ifndef DRIVER_CMD_PROFILE_H
+#define DRIVER_CMD_PROFILE_H
+
+#define PROFILE_CMD			"PROFILE"
+/* Profiles are key=value files, the first one found is used */
+#define PROFILE_FILE_DATA		"/data/misc/wifi/wext_timing.conf"
+#define PROFILE_FILE_SYSTEM		"/system/etc/wifi/wext_timing.conf"
+#define PROFILE_MAX_LINE		128
+
+/*
+ * Timing values used by the driver commands. Defaults are the compile time
+ * constants from driver_cmd_wext.h and driver_cmd_common.h.
+ */
+struct driver_profile {
+	/* Scan timeouts (s) without and with scan completion events */
+	int scan_timeout;
+	int scan_timeout_events;
+	/* CSCAN dwell times (ms) */
+	int cscan_pasv_dwell;
+	int cscan_pasv_dwell_max;
+	int cscan_home_dwell;
+	/* PNO scan interval (s) and back-off */
+	int pno_interval;
+	int pno_repeat;
+	int pno_max_repeat;
+	/* Failed driver commands in a row before reporting HANGED */
+	int sequential_errors;
+};
+
+int wpa_driver_profile_load(void);
+const struct driver_profile * wpa_driver_profile_get(void);
+int wpa_driver_profile_cmd(char *buf, size_t buf_len);
+
+#endif /* DRIVER_CMD_PROFILE_H */
@@ -0,0 +1,304 @@
+/*
+ * Driver interaction for private interface - scan radio cost accounting
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 2 as
+ * published by the Free Software Foundation.
+ *
+ * Alternatively, this software may be distributed under the terms of BSD
+ * license.
+ *
+ */
+
+#include "includes.h"
+
+#include "common.h"
+
+#include "driver_cmd_wext.h"
+#include "driver_cmd_common.h"
+#include "driver_cmd_scan_cost.h"
+#include "driver_cmd_profile.h"
+
+struct scan_cost_stats {
+	unsigned int scans;
+	unsigned int timeouts;
+	/* Time the radio spent on scan channels */
+	unsigned long long radio_ms;
+	/* Part of radio_ms spent away from the channel of the associated AP */
+	unsigned long long offchan_ms;
+	/* Time from start to end of scan including home channel dwells */
+	unsigned long long wall_ms;
+};
+
+static const char *scan_cost_names[SCAN_COST_NUM_REQUESTERS] = {
+	"framework", "bgscan", "pno", "connect"
+};
+
+static struct {
+	struct scan_cost_stats stats[SCAN_COST_NUM_REQUESTERS];
+	/* SIOCSIWSCAN scan waiting for results */
+	int pending;
+	enum scan_cost_requester pending_req;
+	int pending_associated;
+	struct os_time pending_start;
+	int pending_timeout;
+	/* PNO running in firmware */
+	int pno;
+	int pno_channels;
+	int pno_interval;
+	struct os_time pno_start;
+	/* PNO scans since pno_start that were counted before the last reset */
+	unsigned long long pno_reset_scans;
+} scan_cost;
+
+static unsigned long long scan_cost_ms_since(struct os_time *start)
+{
+	struct os_time now, diff;
+
+	os_get_time(&now);
+	if (os_time_before(&now, start))
+		return 0;
+	os_time_sub(&now, start, &diff);
+	return (unsigned long long) diff.sec * 1000 + diff.usec / 1000;
+}
+
+static void scan_cost_account(enum scan_cost_requester req,
+			      unsigned long long radio_ms,
+			      unsigned long long wall_ms, int associated)
+{
+	struct scan_cost_stats *stats = &scan_cost.stats[req];
+
+	stats->scans++;
+	stats->radio_ms += radio_ms;
+	stats->wall_ms += wall_ms;
+	if (associated)
+		stats->offchan_ms += radio_ms;
+	wpa_printf(MSG_DEBUG, "%s: %s scan radio %llu ms wall %llu ms",
+		   __func__, scan_cost_names[req], radio_ms, wall_ms);
+}
+
+/**
+ * wpa_driver_scan_cost_cscan - Account for a CSCAN command
+ * @req: Component that requested the scan
+ * @buf: Encoded CSCAN command as built by wpa_driver_wext_set_cscan_params()
+ * @len: Length of the encoded command
+ * @num_channels: Number of channels scanned for channel 0 (all channels)
+ * @associated: Whether the scan leaves the channel of an associated AP
+ *
+ * The cost is estimated from the channel list and dwell times in the command:
+ * every channel entry costs one dwell time and, when associated, the driver
+ * returns to the home channel for the home dwell time between channels.
+ */
+void wpa_driver_scan_cost_cscan(enum scan_cost_requester req, const char *buf,
+				size_t len, int num_channels, int associated)
+{
+	const struct driver_profile *profile = wpa_driver_profile_get();
+	const u8 *pos = (const u8 *) buf + WEXT_CSCAN_HEADER_SIZE;
+	const u8 *end = (const u8 *) buf + len;
+	unsigned int visits = 0, pasv_dwell = profile->cscan_pasv_dwell;
+	unsigned int actv_dwell = WEXT_CSCAN_PASV_DWELL_TIME;
+	unsigned int home_dwell = profile->cscan_home_dwell, dwell;
+	unsigned long long radio_ms, wall_ms;
+	int type = WEXT_CSCAN_TYPE_DEFAULT;
+
+	if (len <= WEXT_CSCAN_HEADER_SIZE)
+		return;
+
+	while (pos + 1 < end) {
+		switch (*pos) {
+		case WEXT_CSCAN_CHANNEL_SECTION:
+			visits += pos[1] ? 1 : num_channels;
+			pos += 2;
+			break;
+		case WEXT_CSCAN_NPROBE_SECTION:
+		case WEXT_CSCAN_TYPE_SECTION:
+			if (*pos == WEXT_CSCAN_TYPE_SECTION)
+				type = pos[1];
+			pos += 2;
+			break;
+		case WEXT_CSCAN_ACTV_DWELL_SECTION:
+		case WEXT_CSCAN_PASV_DWELL_SECTION:
+		case WEXT_CSCAN_HOME_DWELL_SECTION:
+			if (pos + 2 >= end)
+				return;
+			dwell = pos[1] | (pos[2] << 8);
+			if (*pos == WEXT_CSCAN_ACTV_DWELL_SECTION)
+				actv_dwell = dwell;
+			else if (*pos == WEXT_CSCAN_PASV_DWELL_SECTION)
+				pasv_dwell = dwell;
+			else
+				home_dwell = dwell;
+			pos += 3;
+			break;
+		case WEXT_CSCAN_SSID_SECTION:
+			pos += 2 + pos[1];
+			break;
+		default:
+			wpa_printf(MSG_DEBUG, "%s: unknown section 0x%02x",
+				   __func__, *pos);
+			return;
+		}
+	}
+
+	dwell = type == WEXT_CSCAN_TYPE_PASSIVE ? pasv_dwell : actv_dwell;
+	radio_ms = (unsigned long long) visits * dwell;
+	wall_ms = radio_ms;
+	if (associated && visits > 1)
+		wall_ms += (unsigned long long) (visits - 1) * home_dwell;
+	scan_cost_account(req, radio_ms, wall_ms, associated);
+}
+
+/**
+ * wpa_driver_scan_cost_start - Start measuring a SIOCSIWSCAN scan
+ * @req: Component that requested the scan
+ * @timeout: Scan timeout in seconds
+ * @associated: Whether the scan leaves the channel of an associated AP
+ *
+ * The driver does not report what a SIOCSIWSCAN scan consists of, so its
+ * cost is the measured time until new scan results become available.
+ */
+void wpa_driver_scan_cost_start(enum scan_cost_requester req, int timeout,
+				int associated)
+{
+	if (scan_cost.pending)
+		wpa_driver_scan_cost_done();
+	scan_cost.pending = 1;
+	scan_cost.pending_req = req;
+	scan_cost.pending_associated = associated;
+	scan_cost.pending_timeout = timeout;
+	os_get_time(&scan_cost.pending_start);
+}
+
+/**
+ * wpa_driver_scan_cost_done - Account for the completed SIOCSIWSCAN scan
+ */
+void wpa_driver_scan_cost_done(void)
+{
+	unsigned long long ms;
+
+	if (!scan_cost.pending)
+		return;
+	scan_cost.pending = 0;
+	ms = scan_cost_ms_since(&scan_cost.pending_start);
+	if (ms >= (unsigned long long) scan_cost.pending_timeout * 1000)
+		scan_cost.stats[scan_cost.pending_req].timeouts++;
+	scan_cost_account(scan_cost.pending_req, ms, ms,
+			  scan_cost.pending_associated);
+}
+
+/**
+ * wpa_driver_scan_cost_stop - Stop accounting when the driver is stopped
+ *
+ * A pending SIOCSIWSCAN scan is dropped, as its results will not come, and
+ * PNO, which stops with the firmware, is accounted up to now.
+ */
+void wpa_driver_scan_cost_stop(void)
+{
+	scan_cost.pending = 0;
+	if (scan_cost.pno)
+		wpa_driver_scan_cost_pno(0, scan_cost.pno_channels,
+					 scan_cost.pno_interval);
+}
+
+/*
+ * Number of scans done by the firmware in @secs seconds of PNO: the scan
+ * interval starts at the configured interval and is doubled after every
+ * pno_repeat scans, at most pno_max_repeat times.
+ */
+static unsigned long long scan_cost_pno_scans(unsigned long long secs)
+{
+	const struct driver_profile *profile = wpa_driver_profile_get();
+	unsigned long long t = 0, scans = 0;
+	unsigned int interval = scan_cost.pno_interval;
+	int level, repeat;
+
+	for (level = 0; level <= profile->pno_max_repeat; level++) {
+		for (repeat = 0; repeat < profile->pno_repeat; repeat++) {
+			t += interval;
+			if (t > secs)
+				return scans;
+			scans++;
+		}
+		if (level < profile->pno_max_repeat)
+			interval *= 2;
+	}
+	return scans + (secs - t) / interval;
+}
+
+static unsigned long long scan_cost_pno_elapsed_scans(void)
+{
+	return scan_cost_pno_scans(scan_cost_ms_since(&scan_cost.pno_start) /
+				   1000);
+}
+
+static void scan_cost_pno_account(struct scan_cost_stats *stats)
+{
+	unsigned long long scans, radio_ms;
+
+	scans = scan_cost_pno_elapsed_scans();
+	scans = scans > scan_cost.pno_reset_scans ?
+		scans - scan_cost.pno_reset_scans : 0;
+	radio_ms = scans * scan_cost.pno_channels * WEXT_CSCAN_PASV_DWELL_TIME;
+	stats->scans += scans;
+	stats->radio_ms += radio_ms;
+	stats->wall_ms += radio_ms;
+}
+
+/**
+ * wpa_driver_scan_cost_pno - Account for PNO scans done by the firmware
+ * @enable: Whether PNO is being enabled or disabled
+ * @num_channels: Number of channels in a PNO scan
+ * @interval: Initial PNO scan interval in seconds
+ *
+ * PNO only runs while not associated, so it has no off-channel cost.
+ */
+void wpa_driver_scan_cost_pno(int enable, int num_channels, int interval)
+{
+	if (scan_cost.pno)
+		scan_cost_pno_account(&scan_cost.stats[SCAN_COST_PNO]);
+	scan_cost.pno = enable;
+	scan_cost.pno_channels = num_channels;
+	scan_cost.pno_interval = interval > 0 ? interval :
+		wpa_driver_profile_get()->pno_interval;
+	scan_cost.pno_reset_scans = 0;
+	os_get_time(&scan_cost.pno_start);
+}
+
+/**
+ * wpa_driver_scan_cost_cmd - Handle SCANCOST driver commands
+ * @cmd: Driver command, SCANCOST or SCANCOST-RESET
+ * @buf: Buffer for the reply
+ * @buf_len: Length of the reply buffer
+ * Returns: Length of the reply on success, -1 on failure
+ */
+int wpa_driver_scan_cost_cmd(char *cmd, char *buf, size_t buf_len)
+{
+	struct scan_cost_stats stats;
+	char *pos = buf, *end = buf + buf_len;
+	int i, ret;
+
+	if (os_strcasecmp(cmd, SCAN_COST_RESET_CMD) == 0) {
+		os_memset(scan_cost.stats, 0, sizeof(scan_cost.stats));
+		/* PNO keeps its back-off, only the scans so far are dropped */
+		if (scan_cost.pno)
+			scan_cost.pno_reset_scans =
+				scan_cost_pno_elapsed_scans();
+		return os_snprintf(buf, buf_len, "OK\n");
+	}
+
+	*buf = '\0';
+	for (i = 0; i < SCAN_COST_NUM_REQUESTERS; i++) {
+		os_memcpy(&stats, &scan_cost.stats[i], sizeof(stats));
+		if (i == SCAN_COST_PNO && scan_cost.pno)
+			scan_cost_pno_account(&stats);
+		ret = os_snprintf(pos, end - pos, "%s scans=%u radio_ms=%llu "
+				  "offchan_ms=%llu wall_ms=%llu timeouts=%u\n",
+				  scan_cost_names[i], stats.scans,
+				  stats.radio_ms, stats.offchan_ms,
+				  stats.wall_ms, stats.timeouts);
+		if (ret < 0 || ret >= end - pos)
+			return -1;
+		pos += ret;
+	}
+	return pos - buf;
+}
@@ -0,0 +1,38 @@
+/*
+ * Driver interaction for private interface - scan radio cost accounting
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 2 as
+ * published by the Free Software Foundation.
+ *
+ * Alternatively, this software may be distributed under the terms of BSD
+ * license.
+ *
+ */
+#ifndef DRIVER_CMD_SCAN_COST_H
+#define DRIVER_CMD_SCAN_COST_H
+
+#define SCAN_COST_CMD			"SCANCOST"
+#define SCAN_COST_CMD_SIZE		8
+#define SCAN_COST_RESET_CMD		"SCANCOST-RESET"
+/* Interval for checking completion of SIOCSIWSCAN scans */
+#define SCAN_COST_POLL_US		50000
+
+enum scan_cost_requester {
+	SCAN_COST_FRAMEWORK,
+	SCAN_COST_BGSCAN,
+	SCAN_COST_PNO,
+	SCAN_COST_CONNECT,
+	SCAN_COST_NUM_REQUESTERS
+};
+
+void wpa_driver_scan_cost_cscan(enum scan_cost_requester req, const char *buf,
+				size_t len, int num_channels, int associated);
+void wpa_driver_scan_cost_start(enum scan_cost_requester req, int timeout,
+				int associated);
+void wpa_driver_scan_cost_done(void);
+void wpa_driver_scan_cost_stop(void);
+void wpa_driver_scan_cost_pno(int enable, int num_channels, int interval);
+int wpa_driver_scan_cost_cmd(char *cmd, char *buf, size_t buf_len);
+
+#endif /* DRIVER_CMD_SCAN_COST_H */
@@ -0,0 +1,366 @@
+/*
+ * Driver interaction for private interface - scan result deltas
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 2 as
+ * published by the Free Software Foundation.
+ *
+ * Alternatively, this software may be distributed under the terms of BSD
+ * license.
+ *
+ */
+
+#include "includes.h"
+
+#include "common.h"
+#include "wpa_supplicant_i.h"
+#include "bss.h"
+
+#include "driver_cmd_scan_delta.h"
+
+#define SCAN_DELTA_ADDED	'+'
+#define SCAN_DELTA_REMOVED	'-'
+#define SCAN_DELTA_CHANGED	'~'
+
+#define SCAN_DELTA_FREQ		BIT(0)
+#define SCAN_DELTA_LEVEL	BIT(1)
+#define SCAN_DELTA_CAPS		BIT(2)
+#define SCAN_DELTA_SSID		BIT(3)
+
+struct scan_delta_bss {
+	u8 bssid[ETH_ALEN];
+	u8 ssid[32];
+	u8 ssid_len;
+	u8 seen;
+	u16 caps;
+	int freq;
+	int level;
+};
+
+struct scan_delta_entry {
+	unsigned int gen;
+	char op;
+	u8 changed;
+	struct scan_delta_bss bss;
+};
+
+static struct {
+	/* Last reported state of every BSS; levels only move past hysteresis */
+	struct scan_delta_bss snap[SCAN_DELTA_MAX_BSS];
+	size_t num_snap;
+	struct scan_delta_bss cur[SCAN_DELTA_MAX_BSS];
+	/* Generation of the last scan folded into the snapshot */
+	unsigned int gen;
+	/* Number of BSSes left out of the last snapshot for lack of room */
+	unsigned int truncated;
+	/* Newest generation that has lost entries to ring wrap-around */
+	unsigned int lost_gen;
+	struct scan_delta_entry ring[SCAN_DELTA_RING_SIZE];
+	unsigned int ring_count;
+	int hyst;
+} scan_delta = {
+	.hyst = SCAN_DELTA_HYST_DEF,
+};
+
+static struct scan_delta_bss *scan_delta_find(const u8 *bssid)
+{
+	size_t i;
+
+	for (i = 0; i < scan_delta.num_snap; i++) {
+		if (os_memcmp(scan_delta.snap[i].bssid, bssid, ETH_ALEN) == 0)
+			return &scan_delta.snap[i];
+	}
+	return NULL;
+}
+
+static void scan_delta_add(char op, u8 changed, const struct scan_delta_bss *bss)
+{
+	struct scan_delta_entry *e;
+
+	e = &scan_delta.ring[scan_delta.ring_count % SCAN_DELTA_RING_SIZE];
+	if (scan_delta.ring_count >= SCAN_DELTA_RING_SIZE &&
+	    e->gen > scan_delta.lost_gen)
+		scan_delta.lost_gen = e->gen;
+	e->gen = scan_delta.gen;
+	e->op = op;
+	e->changed = changed;
+	os_memcpy(&e->bss, bss, sizeof(*bss));
+	scan_delta.ring_count++;
+}
+
+static u8 scan_delta_compare(const struct scan_delta_bss *old,
+			     struct scan_delta_bss *cur)
+{
+	u8 changed = 0;
+	int diff = cur->level - old->level;
+
+	if (cur->freq != old->freq)
+		changed |= SCAN_DELTA_FREQ;
+	if (cur->caps != old->caps)
+		changed |= SCAN_DELTA_CAPS;
+	if (cur->ssid_len != old->ssid_len ||
+	    os_memcmp(cur->ssid, old->ssid, cur->ssid_len) != 0)
+		changed |= SCAN_DELTA_SSID;
+	if (diff > scan_delta.hyst || -diff > scan_delta.hyst)
+		changed |= SCAN_DELTA_LEVEL;
+	else
+		cur->level = old->level; /* Jitter: keep the reported level */
+	return changed;
+}
+
+/*
+ * Order BSSes by level, and by BSSID for equal levels, so that the strongest
+ * ones are selected the same way whatever the order of the BSS table.
+ */
+static int scan_delta_weaker(int level, const u8 *bssid,
+			     const struct scan_delta_bss *bss)
+{
+	if (level != bss->level)
+		return level < bss->level;
+	return os_memcmp(bssid, bss->bssid, ETH_ALEN) > 0;
+}
+
+static size_t scan_delta_weakest(size_t num)
+{
+	const struct scan_delta_bss *cur = scan_delta.cur;
+	size_t i, weakest = 0;
+
+	for (i = 1; i < num; i++) {
+		if (scan_delta_weaker(cur[i].level, cur[i].bssid,
+				      &cur[weakest]))
+			weakest = i;
+	}
+	return weakest;
+}
+
+/*
+ * Copy the BSS table into scan_delta.cur. If it has more entries than fit,
+ * the strongest ones are kept so that the BSSes left out do not depend on
+ * the order of the table. Returns the number of entries copied.
+ */
+static size_t scan_delta_collect(struct wpa_supplicant *wpa_s)
+{
+	struct wpa_bss *bss;
+	struct scan_delta_bss *cur;
+	size_t num = 0, weakest;
+
+	scan_delta.truncated = 0;
+	dl_list_for_each(bss, &wpa_s->bss, struct wpa_bss, list) {
+		if (num < SCAN_DELTA_MAX_BSS) {
+			cur = &scan_delta.cur[num++];
+		} else {
+			scan_delta.truncated++;
+			weakest = scan_delta_weakest(num);
+			if (scan_delta_weaker(bss->level, bss->bssid,
+					      &scan_delta.cur[weakest]))
+				continue;
+			cur = &scan_delta.cur[weakest];
+		}
+		os_memcpy(cur->bssid, bss->bssid, ETH_ALEN);
+		cur->ssid_len = bss->ssid_len > sizeof(cur->ssid) ?
+			sizeof(cur->ssid) : bss->ssid_len;
+		os_memcpy(cur->ssid, bss->ssid, cur->ssid_len);
+		cur->seen = 0;
+		cur->caps = bss->caps;
+		cur->freq = bss->freq;
+		cur->level = bss->level;
+	}
+	return num;
+}
+
+/**
+ * wpa_driver_scan_delta_update - Fold new scan results into the snapshot
+ * @wpa_s: Pointer to wpa_supplicant data
+ *
+ * This function is called once for every new set of scan results. It
+ * compares the BSS table against the previously reported set and records the
+ * added, removed and changed BSSes under a new generation number.
+ */
+void wpa_driver_scan_delta_update(struct wpa_supplicant *wpa_s)
+{
+	struct scan_delta_bss *cur, *old;
+	size_t i, num;
+	u8 changed;
+
+	scan_delta.gen++;
+	num = scan_delta_collect(wpa_s);
+
+	for (i = 0; i < num; i++) {
+		cur = &scan_delta.cur[i];
+		old = scan_delta_find(cur->bssid);
+		if (old == NULL) {
+			scan_delta_add(SCAN_DELTA_ADDED, 0, cur);
+			continue;
+		}
+		old->seen = 1;
+		changed = scan_delta_compare(old, cur);
+		if (changed)
+			scan_delta_add(SCAN_DELTA_CHANGED, changed, cur);
+	}
+
+	for (i = 0; i < scan_delta.num_snap; i++) {
+		if (!scan_delta.snap[i].seen)
+			scan_delta_add(SCAN_DELTA_REMOVED, 0,
+				       &scan_delta.snap[i]);
+	}
+
+	os_memcpy(scan_delta.snap, scan_delta.cur, num * sizeof(*cur));
+	scan_delta.num_snap = num;
+
+	if (scan_delta.truncated)
+		wpa_printf(MSG_DEBUG, "%s: %u weakest BSSes not tracked",
+			   __func__, scan_delta.truncated);
+	wpa_printf(MSG_DEBUG, "%s: generation %u, %u BSSes", __func__,
+		   scan_delta.gen, (unsigned int) num);
+}
+
+static int scan_delta_print(char *pos, char *end,
+			    const struct scan_delta_entry *e)
+{
+	const struct scan_delta_bss *bss = &e->bss;
+	char *start = pos;
+	int ret;
+
+	switch (e->op) {
+	case SCAN_DELTA_ADDED:
+		ret = os_snprintf(pos, end - pos, "+ " MACSTR " freq=%d "
+				  "level=%d caps=0x%04x ssid=%s\n",
+				  MAC2STR(bss->bssid), bss->freq, bss->level,
+				  bss->caps,
+				  wpa_ssid_txt(bss->ssid, bss->ssid_len));
+		if (ret < 0 || ret >= end - pos)
+			return -1;
+		return ret;
+	case SCAN_DELTA_REMOVED:
+		ret = os_snprintf(pos, end - pos, "- " MACSTR "\n",
+				  MAC2STR(bss->bssid));
+		if (ret < 0 || ret >= end - pos)
+			return -1;
+		return ret;
+	}
+
+	ret = os_snprintf(pos, end - pos, "~ " MACSTR, MAC2STR(bss->bssid));
+	if (ret < 0 || ret >= end - pos)
+		return -1;
+	pos += ret;
+	if (e->changed & SCAN_DELTA_FREQ) {
+		ret = os_snprintf(pos, end - pos, " freq=%d", bss->freq);
+		if (ret < 0 || ret >= end - pos)
+			return -1;
+		pos += ret;
+	}
+	if (e->changed & SCAN_DELTA_LEVEL) {
+		ret = os_snprintf(pos, end - pos, " level=%d", bss->level);
+		if (ret < 0 || ret >= end - pos)
+			return -1;
+		pos += ret;
+	}
+	if (e->changed & SCAN_DELTA_CAPS) {
+		ret = os_snprintf(pos, end - pos, " caps=0x%04x", bss->caps);
+		if (ret < 0 || ret >= end - pos)
+			return -1;
+		pos += ret;
+	}
+	if (e->changed & SCAN_DELTA_SSID) {
+		ret = os_snprintf(pos, end - pos, " ssid=%s",
+				  wpa_ssid_txt(bss->ssid, bss->ssid_len));
+		if (ret < 0 || ret >= end - pos)
+			return -1;
+		pos += ret;
+	}
+	if (end - pos < 2)
+		return -1;
+	*pos++ = '\n';
+	*pos = '\0';
+	return pos - start;
+}
+
+/*
+ * Reply with every delta entry newer than generation @since, followed by a
+ * "GEN=<n>" line naming the generation the consumer is now in sync with. If
+ * the last scan had more BSSes than are tracked, a "TRUNCATED=<n>" line
+ * before it gives the number of weakest BSSes that are not reported. If
+ * the reply buffer fills up, only complete generations are returned and the
+ * consumer simply asks again. If entries for the requested range have
+ * already been overwritten, or the first generation alone does not fit in
+ * the reply, "RESYNC" tells the consumer to re-read the full scan results
+ * and continue from the returned generation.
+ */
+static int scan_delta_get(unsigned int since, char *buf, size_t buf_len)
+{
+	const struct scan_delta_entry *e;
+	char *pos = buf, *end, *gen_pos = buf;
+	unsigned int i, first, gen = since;
+	int ret;
+
+	if (buf_len < 64)
+		return -1;
+	/* Keep room for the trailing truncation and generation lines */
+	end = buf + buf_len - 48;
+
+	if (since > scan_delta.gen || since < scan_delta.lost_gen)
+		return os_snprintf(buf, buf_len, "RESYNC\nGEN=%u\n",
+				   scan_delta.gen);
+
+	first = scan_delta.ring_count > SCAN_DELTA_RING_SIZE ?
+		scan_delta.ring_count - SCAN_DELTA_RING_SIZE : 0;
+	for (i = first; i < scan_delta.ring_count; i++) {
+		e = &scan_delta.ring[i % SCAN_DELTA_RING_SIZE];
+		if (e->gen <= since)
+			continue;
+		if (e->gen != gen) {
+			/* Everything up to the previous generation is out */
+			gen_pos = pos;
+			gen = e->gen - 1;
+		}
+		ret = scan_delta_print(pos, end, e);
+		if (ret < 0) {
+			/* Asking again would never get past this generation */
+			if (gen_pos == buf)
+				return os_snprintf(buf, buf_len,
+						   "RESYNC\nGEN=%u\n",
+						   scan_delta.gen);
+			pos = gen_pos;
+			break;
+		}
+		pos += ret;
+		gen = e->gen;
+	}
+	if (i == scan_delta.ring_count)
+		gen = scan_delta.gen;
+
+	if (scan_delta.truncated) {
+		ret = os_snprintf(pos, buf + buf_len - pos, "TRUNCATED=%u\n",
+				  scan_delta.truncated);
+		pos += ret;
+	}
+	ret = os_snprintf(pos, buf + buf_len - pos, "GEN=%u\n", gen);
+	return pos - buf + ret;
+}
+
+/**
+ * wpa_driver_scan_delta_cmd - Handle SCAN-DELTA driver commands
+ * @cmd: Driver command, "SCAN-DELTA <generation>" or "SCAN-DELTA-HYST <dB>"
+ * @buf: Buffer for the reply
+ * @buf_len: Length of the reply buffer
+ * Returns: Length of the reply on success, -1 on failure
+ */
+int wpa_driver_scan_delta_cmd(char *cmd, char *buf, size_t buf_len)
+{
+	int hyst;
+
+	if (os_strncasecmp(cmd, SCAN_DELTA_HYST_CMD,
+			   SCAN_DELTA_HYST_CMD_SIZE) == 0) {
+		hyst = atoi(cmd + SCAN_DELTA_HYST_CMD_SIZE);
+		if (hyst < 0 || hyst > SCAN_DELTA_HYST_MAX) {
+			wpa_printf(MSG_ERROR, "%s: invalid hysteresis %d",
+				   __func__, hyst);
+			return -1;
+		}
+		scan_delta.hyst = hyst;
+		return os_snprintf(buf, buf_len, "OK\n");
+	}
+
+	return scan_delta_get(strtoul(cmd + SCAN_DELTA_CMD_SIZE, NULL, 10),
+			      buf, buf_len);
+}
@@ -0,0 +1,34 @@
+/*
+ * Driver interaction for private interface - scan result deltas
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 2 as
+ * published by the Free Software Foundation.
+ *
+ * Alternatively, this software may be distributed under the terms of BSD
+ * license.
+ *
+ */
+#ifndef DRIVER_CMD_SCAN_DELTA_H
+#define DRIVER_CMD_SCAN_DELTA_H
+
+#define SCAN_DELTA_CMD			"SCAN-DELTA"
+#define SCAN_DELTA_CMD_SIZE		10
+#define SCAN_DELTA_HYST_CMD		"SCAN-DELTA-HYST"
+#define SCAN_DELTA_HYST_CMD_SIZE	15
+/*
+ * Number of BSSes tracked in the snapshot the deltas are computed against,
+ * above the default BSS table size of wpa_supplicant (bss_max_count 200)
+ */
+#define SCAN_DELTA_MAX_BSS		256
+/* Number of delta entries kept for consumers that lag behind */
+#define SCAN_DELTA_RING_SIZE		256
+#define SCAN_DELTA_HYST_DEF		0
+#define SCAN_DELTA_HYST_MAX		30
+
+struct wpa_supplicant;
+
+void wpa_driver_scan_delta_update(struct wpa_supplicant *wpa_s);
+int wpa_driver_scan_delta_cmd(char *cmd, char *buf, size_t buf_len);
+
+#endif /* DRIVER_CMD_SCAN_DELTA_H */
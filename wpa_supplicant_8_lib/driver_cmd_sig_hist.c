@@ -0,0 +1,493 @@
+/*
+ * Driver interaction for private interface - signal history
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 2 as
+ * published by the Free Software Foundation.
+ *
+ * Alternatively, this software may be distributed under the terms of BSD
+ * license.
+ *
+ */
+
+#include "includes.h"
+
+#include "common.h"
+
+#include "driver_cmd_sig_hist.h"
+
+#ifndef CLOCK_BOOTTIME
+#define CLOCK_BOOTTIME 7
+#endif
+
+/*
+ * The history is a ring of fixed size blocks. Every block starts with an
+ * absolute key sample in its header followed by varint encoded tokens. The
+ * low bit of the first varint of a token selects the token type and the
+ * remaining bits hold the number of seconds since the previous token:
+ *  - run: RSSI and rate did not change and no retries were seen, only the
+ *    time of the last such sample is stored
+ *  - sample: followed by zig-zag encoded RSSI and rate deltas and the number
+ *    of retries since the previous sample
+ * A stable link thus costs a few bytes per minute instead of a few bytes per
+ * sample, and when the ring is full the oldest block is dropped.
+ */
+#define SIG_HIST_RUN		0
+#define SIG_HIST_SAMPLE		1
+/* Worst case size of a run token followed by a sample token */
+#define SIG_HIST_MAX_ENCODED	18
+/* Worst case size of a run token, flushed when a block is closed */
+#define SIG_HIST_MAX_RUN	5
+/* Rate is stored in units of 100 kbps */
+#define SIG_HIST_RATE_UNIT	100
+/* Samples further apart than this are treated as a gap in the history */
+#define SIG_HIST_GAP		60
+
+struct sig_hist_block {
+	u32 start;
+	s16 rssi;
+	u16 rate;
+	u16 retries;
+	u16 len;
+	u8 data[SIG_HIST_BLOCK_SIZE - 12];
+};
+
+static struct {
+	struct sig_hist_block blocks[SIG_HIST_NUM_BLOCKS];
+	unsigned int head;
+	unsigned int count;
+	/* Time of the last encoded token */
+	u32 last_t;
+	/* Time of the last sample folded into a not yet encoded run */
+	u32 run_t;
+	int rssi;
+	int rate;
+	unsigned int samples;
+} sig_hist;
+
+typedef void (*sig_hist_cb)(void *ctx, u32 t, int gap, int rssi, int rate,
+			    unsigned int retries);
+
+static int sig_hist_put_varint(u8 *pos, u32 val)
+{
+	int len = 0;
+
+	while (val >= 0x80) {
+		pos[len++] = (val & 0x7f) | 0x80;
+		val >>= 7;
+	}
+	pos[len++] = val;
+	return len;
+}
+
+static const u8 * sig_hist_get_varint(const u8 *pos, const u8 *end, u32 *val)
+{
+	u32 v = 0;
+	int shift = 0;
+
+	while (pos < end && shift <= 28) {
+		v |= (u32) (*pos & 0x7f) << shift;
+		if (!(*pos++ & 0x80)) {
+			*val = v;
+			return pos;
+		}
+		shift += 7;
+	}
+	return NULL;
+}
+
+static u32 sig_hist_zigzag(int val)
+{
+	return ((u32) val << 1) ^ (u32) (val >> 31);
+}
+
+static int sig_hist_unzigzag(u32 val)
+{
+	return (int) (val >> 1) ^ -(int) (val & 1);
+}
+
+/*
+ * Seconds since boot, including time spent in suspend. Setting the wall clock
+ * (e.g. by NTP on a board without RTC) neither reorders nor stretches the
+ * history, and suspend shows up as a gap.
+ */
+static u32 sig_hist_now(void)
+{
+	struct timespec ts;
+
+	clock_gettime(CLOCK_BOOTTIME, &ts);
+	return ts.tv_sec;
+}
+
+static void sig_hist_flush_run(struct sig_hist_block *blk)
+{
+	if (sig_hist.run_t <= sig_hist.last_t)
+		return;
+	blk->len += sig_hist_put_varint(blk->data + blk->len,
+					((sig_hist.run_t - sig_hist.last_t) << 1) |
+					SIG_HIST_RUN);
+	sig_hist.last_t = sig_hist.run_t;
+}
+
+static void sig_hist_new_block(u32 t, int rssi, int rate, unsigned int retries)
+{
+	struct sig_hist_block *blk;
+
+	if (sig_hist.count) {
+		sig_hist_flush_run(&sig_hist.blocks[sig_hist.head]);
+		sig_hist.head = (sig_hist.head + 1) % SIG_HIST_NUM_BLOCKS;
+	}
+	if (sig_hist.count < SIG_HIST_NUM_BLOCKS)
+		sig_hist.count++;
+
+	blk = &sig_hist.blocks[sig_hist.head];
+	blk->start = t;
+	blk->rssi = rssi;
+	blk->rate = rate;
+	blk->retries = retries;
+	blk->len = 0;
+
+	sig_hist.last_t = t;
+	sig_hist.run_t = t;
+	sig_hist.rssi = rssi;
+	sig_hist.rate = rate;
+}
+
+/**
+ * wpa_driver_sig_hist_add - Record a link quality sample
+ * @rssi: Signal level in dBm
+ * @rate: Current TX rate in kbps
+ * @retries: Number of retries since the previous sample
+ */
+void wpa_driver_sig_hist_add(int rssi, int rate, unsigned int retries)
+{
+	struct sig_hist_block *blk;
+	u8 *pos;
+	u32 t = sig_hist_now();
+
+	if (rssi < -128)
+		rssi = -128;
+	else if (rssi > 127)
+		rssi = 127;
+	rate /= SIG_HIST_RATE_UNIT;
+	if (rate < 0)
+		rate = 0;
+	else if (rate > 0xffff)
+		rate = 0xffff;
+	if (retries > 0xffff)
+		retries = 0xffff;
+	sig_hist.samples++;
+
+	if (sig_hist.count == 0) {
+		sig_hist_new_block(t, rssi, rate, retries);
+		return;
+	}
+
+	if (rssi == sig_hist.rssi && rate == sig_hist.rate && retries == 0) {
+		sig_hist.run_t = t;
+		return;
+	}
+
+	/* Keep room for the run token flushed when the block is closed */
+	blk = &sig_hist.blocks[sig_hist.head];
+	if (sizeof(blk->data) - blk->len <
+	    SIG_HIST_MAX_ENCODED + SIG_HIST_MAX_RUN) {
+		sig_hist_new_block(t, rssi, rate, retries);
+		return;
+	}
+
+	sig_hist_flush_run(blk);
+	pos = blk->data + blk->len;
+	pos += sig_hist_put_varint(pos, ((t - sig_hist.last_t) << 1) |
+				   SIG_HIST_SAMPLE);
+	pos += sig_hist_put_varint(pos, sig_hist_zigzag(rssi - sig_hist.rssi));
+	pos += sig_hist_put_varint(pos, sig_hist_zigzag(rate - sig_hist.rate));
+	pos += sig_hist_put_varint(pos, retries);
+	blk->len = pos - blk->data;
+
+	sig_hist.last_t = t;
+	sig_hist.run_t = t;
+	sig_hist.rssi = rssi;
+	sig_hist.rate = rate;
+}
+
+/*
+ * Decode the history from the oldest block on and call @cb for every stored
+ * point. Values hold from one point until the next one; @gap is set when the
+ * preceding interval was not covered by samples.
+ */
+static void sig_hist_walk(sig_hist_cb cb, void *ctx)
+{
+	const struct sig_hist_block *blk;
+	const u8 *pos, *end;
+	unsigned int i;
+	u32 tag, val, t, prev_t = 0;
+	int rssi, rate;
+
+	for (i = 0; i < sig_hist.count; i++) {
+		blk = &sig_hist.blocks[(sig_hist.head + SIG_HIST_NUM_BLOCKS -
+					sig_hist.count + 1 + i) %
+				       SIG_HIST_NUM_BLOCKS];
+		t = blk->start;
+		rssi = blk->rssi;
+		rate = blk->rate;
+		cb(ctx, t, i == 0 || t - prev_t > SIG_HIST_GAP, rssi,
+		   rate * SIG_HIST_RATE_UNIT, blk->retries);
+		prev_t = t;
+
+		pos = blk->data;
+		end = pos + blk->len;
+		while (pos < end) {
+			pos = sig_hist_get_varint(pos, end, &tag);
+			if (pos == NULL)
+				break;
+			t += tag >> 1;
+			if ((tag & 1) == SIG_HIST_RUN) {
+				cb(ctx, t, 0, rssi, rate * SIG_HIST_RATE_UNIT, 0);
+				prev_t = t;
+				continue;
+			}
+			pos = sig_hist_get_varint(pos, end, &val);
+			if (pos == NULL)
+				break;
+			rssi += sig_hist_unzigzag(val);
+			pos = sig_hist_get_varint(pos, end, &val);
+			if (pos == NULL)
+				break;
+			rate += sig_hist_unzigzag(val);
+			pos = sig_hist_get_varint(pos, end, &val);
+			if (pos == NULL)
+				break;
+			cb(ctx, t, t - prev_t > SIG_HIST_GAP, rssi,
+			   rate * SIG_HIST_RATE_UNIT, val);
+			prev_t = t;
+		}
+	}
+
+	if (sig_hist.count && sig_hist.run_t > sig_hist.last_t)
+		cb(ctx, sig_hist.run_t, 0, sig_hist.rssi,
+		   sig_hist.rate * SIG_HIST_RATE_UNIT, 0);
+}
+
+struct sig_hist_dump {
+	char *pos;
+	char *end;
+	u32 since;
+	u32 next;
+	int full;
+};
+
+static void sig_hist_dump_cb(void *ctx, u32 t, int gap, int rssi, int rate,
+			     unsigned int retries)
+{
+	struct sig_hist_dump *dump = ctx;
+	int ret;
+
+	if (dump->full || t < dump->since)
+		return;
+	ret = os_snprintf(dump->pos, dump->end - dump->pos, "%u %d %d %u%s\n",
+			  t, rssi, rate, retries, gap ? " gap" : "");
+	if (ret < 0 || ret >= dump->end - dump->pos) {
+		*dump->pos = '\0';
+		dump->full = 1;
+		dump->next = t;
+		return;
+	}
+	dump->pos += ret;
+}
+
+/*
+ * SIGHIST-DUMP [since]: one "<time> <rssi> <rate> <retries>" line per stored
+ * point starting at time @since, in seconds since boot. If the reply does not
+ * fit, it ends with "NEXT=<time>" to be used as @since of the following
+ * request.
+ */
+static int sig_hist_dump(char *cmd, char *buf, size_t buf_len)
+{
+	struct sig_hist_dump dump;
+	int ret;
+
+	if (buf_len < 32)
+		return -1;
+	os_memset(&dump, 0, sizeof(dump));
+	dump.pos = buf;
+	dump.end = buf + buf_len - 20;
+	dump.since = strtoul(cmd, NULL, 10);
+	*buf = '\0';
+
+	sig_hist_walk(sig_hist_dump_cb, &dump);
+
+	if (dump.full) {
+		ret = os_snprintf(dump.pos, buf + buf_len - dump.pos,
+				  "NEXT=%u\n", dump.next);
+		dump.pos += ret;
+	}
+	return dump.pos - buf;
+}
+
+struct sig_hist_bucket {
+	u32 covered;
+	s64 rssi_sum;
+	s64 rate_sum;
+	int rssi_min;
+	int rssi_max;
+	unsigned int retries;
+};
+
+struct sig_hist_query {
+	struct sig_hist_bucket *buckets;
+	unsigned int num;
+	u32 start;
+	u32 step;
+	int have_prev;
+	u32 prev_t;
+	int prev_rssi;
+	int prev_rate;
+};
+
+static void sig_hist_query_segment(struct sig_hist_query *q, u32 from, u32 to,
+				   int rssi, int rate)
+{
+	struct sig_hist_bucket *b;
+	u32 end = q->start + q->num * q->step, seg_end, dur;
+
+	if (from < q->start)
+		from = q->start;
+	if (to > end)
+		to = end;
+	while (from < to) {
+		b = &q->buckets[(from - q->start) / q->step];
+		seg_end = q->start + ((from - q->start) / q->step + 1) * q->step;
+		if (seg_end > to)
+			seg_end = to;
+		dur = seg_end - from;
+		if (b->covered == 0 || rssi < b->rssi_min)
+			b->rssi_min = rssi;
+		if (b->covered == 0 || rssi > b->rssi_max)
+			b->rssi_max = rssi;
+		b->covered += dur;
+		b->rssi_sum += (s64) rssi * dur;
+		b->rate_sum += (s64) rate * dur;
+		from = seg_end;
+	}
+}
+
+static void sig_hist_query_cb(void *ctx, u32 t, int gap, int rssi, int rate,
+			      unsigned int retries)
+{
+	struct sig_hist_query *q = ctx;
+
+	if (q->have_prev && !gap)
+		sig_hist_query_segment(q, q->prev_t, t, q->prev_rssi,
+				       q->prev_rate);
+	if (t >= q->start && t < q->start + q->num * q->step)
+		q->buckets[(t - q->start) / q->step].retries += retries;
+	q->have_prev = 1;
+	q->prev_t = t;
+	q->prev_rssi = rssi;
+	q->prev_rate = rate;
+}
+
+/*
+ * SIGHIST-QUERY [span] [step]: downsample the last @span seconds into buckets
+ * of @step seconds. Every covered bucket is reported as
+ * "<start> <min rssi> <avg rssi> <max rssi> <avg rate> <retries>" with time
+ * weighted averages.
+ */
+static int sig_hist_query(char *cmd, char *buf, size_t buf_len)
+{
+	struct sig_hist_query q;
+	struct sig_hist_bucket *b;
+	u32 now = sig_hist_now();
+	char *pos = buf, *end = buf + buf_len, *next;
+	unsigned int i, span, step;
+	int ret;
+
+	span = strtoul(cmd, &next, 10);
+	step = strtoul(next, NULL, 10);
+	if (span == 0)
+		span = 3600;
+	if (step == 0)
+		step = 60;
+	if (step > span || (span + step - 1) / step > SIG_HIST_MAX_BUCKETS) {
+		wpa_printf(MSG_ERROR, "%s: invalid span %u / step %u",
+			   __func__, span, step);
+		return -1;
+	}
+
+	os_memset(&q, 0, sizeof(q));
+	q.num = (span + step - 1) / step;
+	q.step = step;
+	q.buckets = os_zalloc(q.num * sizeof(*q.buckets));
+	if (q.buckets == NULL)
+		return -1;
+	/* Shortly after boot the span may reach back before time 0 */
+	q.start = now + 1 >= q.num * step ? now + 1 - q.num * step : 0;
+
+	sig_hist_walk(sig_hist_query_cb, &q);
+	if (q.have_prev && now - q.prev_t <= SIG_HIST_GAP)
+		sig_hist_query_segment(&q, q.prev_t, now + 1, q.prev_rssi,
+				       q.prev_rate);
+
+	*buf = '\0';
+	for (i = 0; i < q.num; i++) {
+		b = &q.buckets[i];
+		if (b->covered == 0)
+			continue;
+		ret = os_snprintf(pos, end - pos, "%u %d %d %d %d %u\n",
+				  q.start + i * step, b->rssi_min,
+				  (int) (b->rssi_sum / b->covered),
+				  b->rssi_max, (int) (b->rate_sum / b->covered),
+				  b->retries);
+		if (ret < 0 || ret >= end - pos) {
+			*pos = '\0';
+			break;
+		}
+		pos += ret;
+	}
+	os_free(q.buckets);
+	return pos - buf;
+}
+
+static int sig_hist_info(char *buf, size_t buf_len)
+{
+	unsigned int i, used = 0;
+	u32 oldest = 0;
+
+	for (i = 0; i < sig_hist.count; i++)
+		used += SIG_HIST_BLOCK_SIZE - sizeof(sig_hist.blocks[i].data) +
+			sig_hist.blocks[i].len;
+	if (sig_hist.count)
+		oldest = sig_hist.blocks[(sig_hist.head + SIG_HIST_NUM_BLOCKS -
+					  sig_hist.count + 1) %
+					 SIG_HIST_NUM_BLOCKS].start;
+
+	return os_snprintf(buf, buf_len, "blocks=%u/%u bytes=%u/%u "
+			   "samples=%u oldest=%u\n", sig_hist.count,
+			   SIG_HIST_NUM_BLOCKS, used,
+			   (unsigned int) sizeof(sig_hist.blocks),
+			   sig_hist.samples, oldest);
+}
+
+/**
+ * wpa_driver_sig_hist_cmd - Handle SIGHIST driver commands
+ * @cmd: Driver command, SIGHIST-DUMP, SIGHIST-QUERY or SIGHIST-INFO
+ * @buf: Buffer for the reply
+ * @buf_len: Length of the reply buffer
+ * Returns: Length of the reply on success, -1 on failure
+ */
+int wpa_driver_sig_hist_cmd(char *cmd, char *buf, size_t buf_len)
+{
+	if (os_strncasecmp(cmd, SIG_HIST_DUMP_CMD, SIG_HIST_DUMP_CMD_SIZE) == 0)
+		return sig_hist_dump(cmd + SIG_HIST_DUMP_CMD_SIZE, buf,
+				     buf_len);
+	if (os_strncasecmp(cmd, SIG_HIST_QUERY_CMD,
+			   SIG_HIST_QUERY_CMD_SIZE) == 0)
+		return sig_hist_query(cmd + SIG_HIST_QUERY_CMD_SIZE, buf,
+				      buf_len);
+	if (os_strcasecmp(cmd, SIG_HIST_INFO_CMD) == 0)
+		return sig_hist_info(buf, buf_len);
+
+	wpa_printf(MSG_ERROR, "%s: unknown command %s", __func__, cmd);
+	return -1;
+}
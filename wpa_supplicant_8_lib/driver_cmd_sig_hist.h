@@ -0,0 +1,32 @@
+/*
+ * Driver interaction for private interface - signal history
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 2 as
+ * published by the Free Software Foundation.
+ *
+ * Alternatively, this software may be distributed under the terms of BSD
+ * license.
+ *
+ */
+#ifndef DRIVER_CMD_SIG_HIST_H
+#define DRIVER_CMD_SIG_HIST_H
+
+#define SIG_HIST_CMD			"SIGHIST"
+#define SIG_HIST_CMD_SIZE		7
+#define SIG_HIST_DUMP_CMD		"SIGHIST-DUMP"
+#define SIG_HIST_DUMP_CMD_SIZE		12
+#define SIG_HIST_QUERY_CMD		"SIGHIST-QUERY"
+#define SIG_HIST_QUERY_CMD_SIZE		13
+#define SIG_HIST_INFO_CMD		"SIGHIST-INFO"
+
+/* Memory budget is SIG_HIST_NUM_BLOCKS * SIG_HIST_BLOCK_SIZE = 64KB */
+#define SIG_HIST_BLOCK_SIZE		256
+#define SIG_HIST_NUM_BLOCKS		256
+/* Maximum number of buckets returned by SIGHIST-QUERY */
+#define SIG_HIST_MAX_BUCKETS		96
+
+void wpa_driver_sig_hist_add(int rssi, int rate, unsigned int retries);
+int wpa_driver_sig_hist_cmd(char *cmd, char *buf, size_t buf_len);
+
+#endif /* DRIVER_CMD_SIG_HIST_H */
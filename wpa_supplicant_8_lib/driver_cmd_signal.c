@@ -0,0 +1,241 @@
+/*
+ * Driver interaction for private interface - adaptive signal sampling
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 2 as
+ * published by the Free Software Foundation.
+ *
+ * Alternatively, this software may be distributed under the terms of BSD
+ * license.
+ *
+ */
+
+#include "includes.h"
+
+#include "common.h"
+
+#include "driver_cmd_events.h"
+#include "driver_cmd_signal.h"
+
+#ifndef CLOCK_BOOTTIME
+#define CLOCK_BOOTTIME 7
+#endif
+
+/*
+ * The signal is sampled from the driver at an interval that starts at
+ * SIGNAL_POLL_MIN_MS and doubles after every calm sample, up to
+ * SIGNAL_POLL_MAX_MS. A sample is not calm when the RSSI variance is high,
+ * the RSSI is close to a threshold that subscribers are notified of or there
+ * is traffic; the interval then drops back to the minimum. Readers get the
+ * latest sample as long as it is younger than the current interval and was
+ * taken on the same BSS; after a roam the link is sampled from scratch.
+ */
+static const int signal_thresholds[] = EVENTS_RSSI_THRESHOLDS;
+
+static struct {
+	struct signal_sample last;
+	u8 bssid[ETH_ALEN];
+	/* Time of the latest sample, ms since boot */
+	long long last_ms;
+	int have_sample;
+	/* Smoothed RSSI in 1/16 dB and its variance in 1/16 dB^2 */
+	int mean;
+	int variance;
+	unsigned int valid_samples;
+	/* Packets sent and received, for the traffic rate */
+	unsigned long long packets;
+	int have_packets;
+	int pps;
+	int interval;
+	const char *reason;
+	unsigned int reads;
+	unsigned int cache_hits;
+} sampler;
+
+static int signal_read_packets(const char *ifname, unsigned long long *packets)
+{
+	static const char *dirs[] = { "rx", "tx" };
+	char path[128];
+	unsigned long long val;
+	unsigned int i;
+	FILE *f;
+	int ret;
+
+	*packets = 0;
+	for (i = 0; i < ARRAY_SIZE(dirs); i++) {
+		os_snprintf(path, sizeof(path), SIGNAL_STATS_PATH, ifname,
+			    dirs[i]);
+		f = fopen(path, "r");
+		if (f == NULL)
+			return -1;
+		ret = fscanf(f, "%llu", &val);
+		fclose(f);
+		if (ret != 1)
+			return -1;
+		*packets += val;
+	}
+	return 0;
+}
+
+static void signal_update_traffic(const char *ifname, int elapsed_ms)
+{
+	unsigned long long packets;
+
+	if (signal_read_packets(ifname, &packets) < 0) {
+		sampler.have_packets = 0;
+		sampler.pps = 0;
+		return;
+	}
+	if (sampler.have_packets && elapsed_ms > 0 && packets >= sampler.packets)
+		sampler.pps = (packets - sampler.packets) * 1000 / elapsed_ms;
+	else
+		sampler.pps = 0;
+	sampler.packets = packets;
+	sampler.have_packets = 1;
+}
+
+static void signal_update_rssi(int rssi)
+{
+	int d = rssi * 16 - sampler.mean;
+
+	if (sampler.valid_samples++ == 0) {
+		sampler.mean = rssi * 16;
+		sampler.variance = 0;
+		return;
+	}
+	sampler.mean += d / 4;
+	sampler.variance += (d * d / 16 - sampler.variance) / 4;
+}
+
+static int signal_near_threshold(int rssi)
+{
+	unsigned int i;
+	int d;
+
+	for (i = 0; i < ARRAY_SIZE(signal_thresholds); i++) {
+		d = rssi - signal_thresholds[i];
+		if (d >= -SIGNAL_THRESHOLD_MARGIN &&
+		    d <= SIGNAL_THRESHOLD_MARGIN)
+			return 1;
+	}
+	return 0;
+}
+
+/*
+ * Milliseconds since boot. Unlike the wall clock this is not set back, so a
+ * sample never looks younger than it is.
+ */
+static long long signal_now_ms(void)
+{
+	struct timespec ts;
+
+	clock_gettime(CLOCK_BOOTTIME, &ts);
+	return (long long) ts.tv_sec * 1000 + ts.tv_nsec / 1000000;
+}
+
+static int signal_age_ms(long long now)
+{
+	return now - sampler.last_ms;
+}
+
+/* Forget the previous link when the samples come from another BSS */
+static void signal_check_bssid(const u8 *bssid)
+{
+	if (sampler.have_sample &&
+	    os_memcmp(sampler.bssid, bssid, ETH_ALEN) != 0)
+		wpa_driver_signal_reset();
+}
+
+/**
+ * wpa_driver_signal_update - Record a sample read from the driver
+ * @ifname: Interface name, for the traffic statistics
+ * @bssid: BSSID of the AP the sample was taken on
+ * @sample: The new sample
+ * Returns: Time in ms until the next sample should be taken
+ */
+int wpa_driver_signal_update(const char *ifname, const u8 *bssid,
+			     const struct signal_sample *sample)
+{
+	long long now = signal_now_ms();
+
+	signal_check_bssid(bssid);
+	signal_update_traffic(ifname, sampler.have_sample ?
+			      signal_age_ms(now) : 0);
+	if (sample->valid)
+		signal_update_rssi(sample->rssi);
+	sampler.last = *sample;
+	os_memcpy(sampler.bssid, bssid, ETH_ALEN);
+	sampler.last_ms = now;
+	sampler.have_sample = 1;
+	sampler.reads++;
+
+	if (!sample->valid) {
+		/* Nothing to adapt to, only check back now and then */
+		sampler.interval = SIGNAL_POLL_MAX_MS;
+		sampler.reason = "no-stats";
+	} else if (sampler.variance > SIGNAL_VARIANCE_HIGH * 16) {
+		sampler.interval = SIGNAL_POLL_MIN_MS;
+		sampler.reason = "variance";
+	} else if (signal_near_threshold(sample->rssi)) {
+		sampler.interval = SIGNAL_POLL_MIN_MS;
+		sampler.reason = "threshold";
+	} else if (sampler.pps >= SIGNAL_TRAFFIC_PPS) {
+		sampler.interval = SIGNAL_POLL_MIN_MS;
+		sampler.reason = "traffic";
+	} else {
+		sampler.interval = sampler.interval ? sampler.interval * 2 :
+			SIGNAL_POLL_MIN_MS;
+		if (sampler.interval > SIGNAL_POLL_MAX_MS)
+			sampler.interval = SIGNAL_POLL_MAX_MS;
+		sampler.reason = "stable";
+	}
+	return sampler.interval;
+}
+
+/**
+ * wpa_driver_signal_cached - Get the latest sample if it is still current
+ * @bssid: BSSID of the AP currently associated with
+ * Returns: The latest sample or %NULL if a new one has to be read
+ */
+const struct signal_sample * wpa_driver_signal_cached(const u8 *bssid)
+{
+	signal_check_bssid(bssid);
+	if (!sampler.have_sample)
+		return NULL;
+	if (signal_age_ms(signal_now_ms()) >= sampler.interval)
+		return NULL;
+	sampler.cache_hits++;
+	return &sampler.last;
+}
+
+/**
+ * wpa_driver_signal_reset - Forget the link after a disconnection
+ */
+void wpa_driver_signal_reset(void)
+{
+	sampler.have_sample = 0;
+	sampler.valid_samples = 0;
+	sampler.have_packets = 0;
+	sampler.pps = 0;
+	sampler.interval = 0;
+}
+
+/**
+ * wpa_driver_signal_cmd - Handle SIGNAL driver command
+ * @buf: Buffer for the reply
+ * @buf_len: Length of the reply buffer
+ * Returns: Length of the reply on success, -1 on failure
+ */
+int wpa_driver_signal_cmd(char *buf, size_t buf_len)
+{
+	if (!sampler.have_sample)
+		return os_snprintf(buf, buf_len, "reads=%u cache_hits=%u\n",
+				   sampler.reads, sampler.cache_hits);
+	return os_snprintf(buf, buf_len, "rssi=%d txrate=%d valid=%d "
+			   "age_ms=%d interval_ms=%d reason=%s variance=%d "
+			   "pps=%d reads=%u cache_hits=%u\n", sampler.last.rssi,
+			   sampler.last.txrate, sampler.last.valid,
+			   signal_age_ms(signal_now_ms()), sampler.interval,
+			   sampler.reason, sampler.variance / 16, sampler.pps,
+			   sampler.reads, sampler.cache_hits);
+}
@@ -0,0 +1,48 @@
+/*
+ * Driver interaction for private interface - adaptive signal sampling
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 2 as
+ * published by the Free Software Foundation.
+ *
+ * Alternatively, this software may be distributed under the terms of BSD
+ * license.
+ *
+ */
+#ifndef DRIVER_CMD_SIGNAL_H
+#define DRIVER_CMD_SIGNAL_H
+
+#define SIGNAL_CMD			"SIGNAL"
+
+/* Sampling interval limits (ms), the interval doubles while the link is calm */
+#define SIGNAL_POLL_MIN_MS		2000
+#define SIGNAL_POLL_MAX_MS		32000
+/* RSSI variance (dB^2) above which the link counts as unstable */
+#define SIGNAL_VARIANCE_HIGH		4
+/* Distance (dB) to an RSSI event threshold that counts as near */
+#define SIGNAL_THRESHOLD_MARGIN		4
+/* Packets per second in either direction that count as traffic */
+#define SIGNAL_TRAFFIC_PPS		100
+#define SIGNAL_STATS_PATH		"/sys/class/net/%s/statistics/%s_packets"
+
+/* Values reported when the driver does not provide statistics */
+#define SIGNAL_DEFAULT_RSSI		-60
+#define SIGNAL_DEFAULT_TXRATE		150000
+
+struct signal_sample {
+	int rssi;
+	/* Transmit rate in kbps */
+	int txrate;
+	/* Cumulative number of retries */
+	unsigned int retries;
+	/* Whether the values were read from the driver */
+	int valid;
+};
+
+int wpa_driver_signal_update(const char *ifname, const u8 *bssid,
+			     const struct signal_sample *sample);
+const struct signal_sample * wpa_driver_signal_cached(const u8 *bssid);
+void wpa_driver_signal_reset(void);
+int wpa_driver_signal_cmd(char *buf, size_t buf_len);
+
+#endif /* DRIVER_CMD_SIGNAL_H */
@@ -12,6 +12,7 @@
 
 #include "includes.h"
 #include <sys/ioctl.h>
+#include <sys/stat.h>
 #include <net/if_arp.h>
 #include <net/if.h>
 
@@ -28,21 +29,504 @@
 #include "config.h"
 #include "linux_ioctl.h"
 #include "scan.h"
+#include "bss.h"
 
 #include "driver_cmd_wext.h"
 #include "driver_cmd_common.h"
+#include "driver_cmd_scan_delta.h"
+#include "driver_cmd_sig_hist.h"
+#include "driver_cmd_scan_cost.h"
+#include "driver_cmd_metrics.h"
+#include "driver_cmd_events.h"
+#include "driver_cmd_mobility.h"
+#include "driver_cmd_predict.h"
+#include "driver_cmd_profile.h"
+#include "driver_cmd_signal.h"
+
+/* Number of channels scanned for CSCAN channel 0, as set by SCAN-CHANNELS */
+static int wext_scan_channels = WEXT_NUMBER_SCAN_CHANNELS_FCC;
+/* PNO scan interval programmed by the last PNOSETUP */
+static int wext_pno_interval = WEXT_PNO_SCAN_INTERVAL;
+/* Scan interval configured in wpa_supplicant and the one set from it */
+static int wext_scan_interval_base;
+static int wext_scan_interval;
+
+/* Network to scan for after a fingerprint cache hit */
+static struct predict_target wext_predict_target;
+/* Remaining retries of the scan for wext_predict_target */
+static int wext_predict_retries;
+/* Time until which wpa_driver_wext_scan_poll() waits for scan results */
+static struct os_time wext_scan_poll_end;
+/* Cumulative retry count of the last signal sample, 0 if none */
+static unsigned int wext_signal_retries;
+
+static int wpa_driver_set_backgroundscan_params(void *priv);
+static int wpa_driver_wext_set_scan_timeout(void *priv);
+
+static int wpa_driver_wext_ioctl(struct wpa_driver_wext_data *drv,
+				 unsigned long request, struct iwreq *iwr)
+{
+	int ret;
+
+	wpa_driver_metrics_ioctl_start();
+	ret = ioctl(drv->ioctl_sock, request, iwr);
+	wpa_driver_metrics_ioctl_done(ret);
+	return ret;
+}
+
+static void wpa_driver_wext_send_hanged(struct wpa_driver_wext_data *drv)
+{
+	wpa_driver_metrics_hanged();
+	wpa_driver_events_publish(DRIVER_EVENT_HANGED, 0, 0, 0);
+	wpa_msg(drv->ctx, MSG_INFO, WPA_EVENT_DRIVER_STATE "HANGED");
+}
+
+/*
+ * wpa_driver_wext_deinit() frees the wext data without calling into this
+ * library, so a timer registered with the data as context could fire after
+ * it is gone. The timers of this library use wext_timer as context instead
+ * and get the data from wpa_driver_wext_timer_drv(), which only returns it
+ * while its ioctl socket is still open: wpa_driver_wext_deinit() closes the
+ * socket before freeing the data. A new socket reusing the descriptor number
+ * is told apart by its inode.
+ */
+static struct {
+	struct wpa_driver_wext_data *drv;
+	int sock;
+	dev_t dev;
+	ino_t ino;
+} wext_timer = {
+	.sock = -1,
+};
+
+static void wpa_driver_wext_timer_attach(struct wpa_driver_wext_data *drv)
+{
+	struct stat st;
+
+	if (fstat(drv->ioctl_sock, &st) < 0) {
+		wext_timer.drv = NULL;
+		return;
+	}
+	wext_timer.drv = drv;
+	wext_timer.sock = drv->ioctl_sock;
+	wext_timer.dev = st.st_dev;
+	wext_timer.ino = st.st_ino;
+}
+
+static struct wpa_driver_wext_data * wpa_driver_wext_timer_drv(void)
+{
+	struct stat st;
+
+	if (wext_timer.drv == NULL)
+		return NULL;
+	if (fstat(wext_timer.sock, &st) < 0 || st.st_dev != wext_timer.dev ||
+	    st.st_ino != wext_timer.ino) {
+		wpa_printf(MSG_DEBUG, "%s: driver deinitialized", __func__);
+		wext_timer.drv = NULL;
+		return NULL;
+	}
+	return wext_timer.drv;
+}
+
+static void wpa_driver_wext_timer_register(struct wpa_driver_wext_data *drv,
+					   unsigned int secs,
+					   unsigned int usecs,
+					   eloop_timeout_handler handler)
+{
+	wpa_driver_wext_timer_attach(drv);
+	eloop_cancel_timeout(handler, &wext_timer, NULL);
+	eloop_register_timeout(secs, usecs, handler, &wext_timer, NULL);
+}
+
+static void wpa_driver_wext_timer_cancel(eloop_timeout_handler handler)
+{
+	eloop_cancel_timeout(handler, &wext_timer, NULL);
+}
+
+/**
+ * wpa_driver_wext_predict_scan - Scan for a predicted network
+ * @eloop_ctx: Not used, the wext data comes from wpa_driver_wext_timer_drv()
+ * @timeout_ctx: Not used
+ *
+ * Requests a SIOCSIWSCAN scan for the SSID of the predicted network on its
+ * frequency only, so it is found without waiting for a sweep of all
+ * channels. Private commands like CSCAN are not supported by all drivers.
+ * If wpa_supplicant is scanning itself, the scan is retried a few times.
+ */
+static void wpa_driver_wext_predict_scan(void *eloop_ctx, void *timeout_ctx)
+{
+	struct wpa_driver_wext_data *drv = wpa_driver_wext_timer_drv();
+	const struct predict_target *target = &wext_predict_target;
+	struct wpa_supplicant *wpa_s;
+	struct iw_scan_req req;
+	struct iwreq iwr;
+	int timeout;
+
+	if (drv == NULL)
+		return;
+	wpa_s = (struct wpa_supplicant *)(drv->ctx);
+	if (target->freq <= 0 || wpa_s->wpa_state > WPA_SCANNING)
+		return;
+	if (wpa_s->scanning) {
+		if (wext_predict_retries-- > 0)
+			wpa_driver_wext_timer_register(drv, 0,
+						       PREDICT_SCAN_RETRY_US,
+						       wpa_driver_wext_predict_scan);
+		return;
+	}
+
+	os_memset(&req, 0, sizeof(req));
+	req.essid_len = target->ssid_len;
+	req.bssid.sa_family = ARPHRD_ETHER;
+	os_memset(req.bssid.sa_data, 0xff, ETH_ALEN);
+	os_memcpy(req.essid, target->ssid, target->ssid_len);
+	req.num_channels = 1;
+	req.channel_list[0].m = target->freq * 100000;
+	req.channel_list[0].e = 1;
+
+	os_memset(&iwr, 0, sizeof(iwr));
+	os_strlcpy(iwr.ifr_name, drv->ifname, IFNAMSIZ);
+	iwr.u.data.pointer = (caddr_t) &req;
+	iwr.u.data.length = sizeof(req);
+	iwr.u.data.flags = IW_SCAN_THIS_ESSID | IW_SCAN_THIS_FREQ;
+
+	if (wpa_driver_wext_ioctl(drv, SIOCSIWSCAN, &iwr) < 0) {
+		wpa_printf(MSG_DEBUG, "%s: scan on %d MHz failed", __func__,
+			   target->freq);
+		return;
+	}
+	timeout = wpa_driver_wext_set_scan_timeout(drv);
+	wpa_driver_scan_cost_start(SCAN_COST_CONNECT, timeout, 0);
+	wpa_driver_predict_scan_started();
+	wpa_supplicant_notify_scanning(wpa_s, 1);
+}
+
+/*
+ * Scale the interval between the scans wpa_supplicant schedules itself while
+ * looking for a network to the mobility state. An interval set by
+ * SCAN_INTERVAL since the last call becomes the new base.
+ */
+static void wpa_driver_wext_update_scan_interval(struct wpa_supplicant *wpa_s)
+{
+	if (wpa_s->scan_interval != wext_scan_interval)
+		wext_scan_interval_base = wpa_s->scan_interval;
+	wext_scan_interval =
+		wpa_driver_mobility_scan_interval(wext_scan_interval_base,
+						  WEXT_SCAN_INTERVAL_MIN,
+						  WEXT_SCAN_INTERVAL_MAX);
+	wpa_printf(MSG_DEBUG, "%s: scan interval %d -> %d seconds", __func__,
+		   wext_scan_interval_base, wext_scan_interval);
+	wpa_s->scan_interval = wext_scan_interval;
+}
+
+/**
+ * wpa_driver_wext_check_scan_results - Process scan results not seen yet
+ * @drv: Pointer to private wext data from wpa_driver_wext_init()
+ *
+ * The BSS table is updated by wpa_supplicant core without notifying this
+ * library, so this is called from every entry point (and before a new scan
+ * is requested) to handle each set of scan results exactly once. Returns 1
+ * if there were new scan results.
+ */
+static int wpa_driver_wext_check_scan_results(struct wpa_driver_wext_data *drv)
+{
+	static unsigned int bss_update_idx;
+	struct wpa_supplicant *wpa_s = (struct wpa_supplicant *)(drv->ctx);
+
+	if (wpa_s == NULL || wpa_s->bss_update_idx == bss_update_idx)
+		return 0;
+	bss_update_idx = wpa_s->bss_update_idx;
+
+	wpa_driver_scan_cost_done();
+	wpa_driver_scan_delta_update(wpa_s);
+	wpa_driver_events_publish(DRIVER_EVENT_SCAN_RESULTS, 0, wpa_s->num_bss,
+				  0);
+
+	if (wpa_driver_mobility_update(wpa_s)) {
+		wpa_driver_events_publish(DRIVER_EVENT_MOBILITY, 0,
+					  wpa_driver_mobility_state(), 0);
+		wpa_driver_wext_update_scan_interval(wpa_s);
+		/* Reprogram PNO with an interval matching the new state */
+		if (drv->bgscan_enabled &&
+		    wpa_driver_set_backgroundscan_params(drv) == 0)
+			wpa_driver_scan_cost_pno(1, wext_scan_channels,
+						 wext_pno_interval);
+	}
+
+	/* Scan after the caller is done, it may be about to scan itself */
+	wpa_driver_wext_timer_cancel(wpa_driver_wext_predict_scan);
+	if (wpa_driver_predict_scan_results(wpa_s, &wext_predict_target)) {
+		wext_predict_retries = PREDICT_SCAN_RETRIES;
+		wpa_driver_wext_timer_register(drv, 0, 0,
+					       wpa_driver_wext_predict_scan);
+	}
+	return 1;
+}
+
+/**
+ * wpa_driver_wext_scan_poll - Wait for the results of a requested scan
+ * @eloop_ctx: Not used, the wext data comes from wpa_driver_wext_timer_drv()
+ * @timeout_ctx: Not used
+ *
+ * Scan results are processed by wpa_supplicant core, so poll for them to
+ * report them to event subscribers without delay and to measure how long a
+ * SIOCSIWSCAN scan kept the radio busy.
+ */
+static void wpa_driver_wext_scan_poll(void *eloop_ctx, void *timeout_ctx)
+{
+	struct wpa_driver_wext_data *drv = wpa_driver_wext_timer_drv();
+	struct os_time now;
+
+	if (drv == NULL || wpa_driver_wext_check_scan_results(drv))
+		return;
+	os_get_time(&now);
+	if (!os_time_before(&now, &wext_scan_poll_end)) {
+		/* Accounts a pending SIOCSIWSCAN scan as timed out */
+		wpa_driver_scan_cost_done();
+		return;
+	}
+	wpa_driver_wext_timer_register(drv, 0, SCAN_COST_POLL_US,
+				       wpa_driver_wext_scan_poll);
+}
+
+static void wpa_driver_wext_scan_poll_start(struct wpa_driver_wext_data *drv,
+					    int timeout)
+{
+	os_get_time(&wext_scan_poll_end);
+	wext_scan_poll_end.sec += timeout;
+	wpa_driver_wext_timer_register(drv, 0, SCAN_COST_POLL_US,
+				       wpa_driver_wext_scan_poll);
+}
+
+/**
+ * wpa_driver_wext_read_signal - Read the signal statistics of the link
+ * @drv: Pointer to private wext data from wpa_driver_wext_init()
+ * @sample: Filled in with the statistics, or default values if not available
+ */
+static void wpa_driver_wext_read_signal(struct wpa_driver_wext_data *drv,
+					struct signal_sample *sample)
+{
+	struct iw_statistics stats;
+	struct iwreq iwr;
+
+	sample->rssi = SIGNAL_DEFAULT_RSSI;
+	sample->txrate = SIGNAL_DEFAULT_TXRATE;
+	sample->retries = 0;
+	sample->valid = 0;
+
+	os_memset(&stats, 0, sizeof(stats));
+	os_memset(&iwr, 0, sizeof(iwr));
+	os_strlcpy(iwr.ifr_name, drv->ifname, IFNAMSIZ);
+	iwr.u.data.pointer = (caddr_t) &stats;
+	iwr.u.data.length = sizeof(stats);
+	iwr.u.data.flags = 1; /* Clear the updated flags */
+	if (wpa_driver_wext_ioctl(drv, SIOCGIWSTATS, &iwr) < 0 ||
+	    (stats.qual.updated & IW_QUAL_LEVEL_INVALID) ||
+	    !(stats.qual.updated & IW_QUAL_DBM))
+		return;
+	/* The level is an 8 bit two's complement dBm value */
+	sample->rssi = stats.qual.level >= 64 ? stats.qual.level - 0x100 :
+		stats.qual.level;
+	sample->retries = stats.discard.retries;
+	sample->valid = 1;
+
+	os_memset(&iwr, 0, sizeof(iwr));
+	os_strlcpy(iwr.ifr_name, drv->ifname, IFNAMSIZ);
+	if (wpa_driver_wext_ioctl(drv, SIOCGIWRATE, &iwr) == 0 &&
+	    iwr.u.bitrate.value > 0)
+		sample->txrate = iwr.u.bitrate.value / 1000;
+}
+
+static void wpa_driver_wext_signal_timer(void *eloop_ctx, void *timeout_ctx);
+
+static int wpa_driver_wext_signal_link_up(struct wpa_driver_wext_data *drv)
+{
+	struct wpa_supplicant *wpa_s = (struct wpa_supplicant *)(drv->ctx);
+
+	return drv->driver_is_started && wpa_s &&
+		wpa_s->wpa_state == WPA_COMPLETED;
+}
+
+static void wpa_driver_wext_signal_stop(void)
+{
+	wpa_driver_wext_timer_cancel(wpa_driver_wext_signal_timer);
+	wpa_driver_signal_reset();
+	wpa_driver_events_rssi_reset();
+	wext_signal_retries = 0;
+}
+
+/*
+ * Take a new signal sample and report it. Samples are taken when a reader
+ * finds the cached one expired; only while RSSI events have subscribers the
+ * next one is scheduled at the interval chosen for the link conditions.
+ */
+static void wpa_driver_wext_signal_sample(struct wpa_driver_wext_data *drv,
+					  struct signal_sample *sample)
+{
+	struct wpa_supplicant *wpa_s = (struct wpa_supplicant *)(drv->ctx);
+	unsigned int retries = 0;
+	int interval;
+
+	wpa_driver_wext_read_signal(drv, sample);
+	interval = wpa_driver_signal_update(drv->ifname, wpa_s->bssid, sample);
+	/* The default values of a failed read are not reported */
+	if (sample->valid) {
+		if (wext_signal_retries && sample->retries >= wext_signal_retries)
+			retries = sample->retries - wext_signal_retries;
+		wext_signal_retries = sample->retries;
+
+		wpa_driver_sig_hist_add(sample->rssi, sample->txrate, retries);
+		wpa_driver_metrics_signal(sample->rssi, sample->txrate);
+		wpa_driver_events_rssi(sample->rssi);
+	}
+
+	wpa_driver_wext_timer_cancel(wpa_driver_wext_signal_timer);
+	if (wpa_driver_events_subscribed(DRIVER_EVENT_RSSI))
+		wpa_driver_wext_timer_register(drv, interval / 1000,
+					       (interval % 1000) * 1000,
+					       wpa_driver_wext_signal_timer);
+}
+
+/**
+ * wpa_driver_wext_signal_get - Get the current signal of the link
+ * @drv: Pointer to private wext data from wpa_driver_wext_init()
+ * @sample: Filled in with the signal, or default values if not associated
+ * Returns: 0 if associated, -1 if not
+ *
+ * The driver is only asked when the cached sample is older than the sampling
+ * interval or was taken on another BSS. Sampling stops when the link goes
+ * down.
+ */
+static int wpa_driver_wext_signal_get(struct wpa_driver_wext_data *drv,
+				      struct signal_sample *sample)
+{
+	struct wpa_supplicant *wpa_s = (struct wpa_supplicant *)(drv->ctx);
+	const struct signal_sample *cached;
+
+	if (!wpa_driver_wext_signal_link_up(drv)) {
+		wpa_driver_wext_signal_stop();
+		sample->rssi = SIGNAL_DEFAULT_RSSI;
+		sample->txrate = SIGNAL_DEFAULT_TXRATE;
+		sample->retries = 0;
+		sample->valid = 0;
+		return -1;
+	}
+
+	cached = wpa_driver_signal_cached(wpa_s->bssid);
+	if (cached)
+		*sample = *cached;
+	else
+		wpa_driver_wext_signal_sample(drv, sample);
+	return 0;
+}
+
+static void wpa_driver_wext_signal_timer(void *eloop_ctx, void *timeout_ctx)
+{
+	struct wpa_driver_wext_data *drv = wpa_driver_wext_timer_drv();
+	struct signal_sample sample;
+
+	if (drv == NULL)
+		return;
+	if (!wpa_driver_wext_signal_link_up(drv))
+		wpa_driver_wext_signal_stop();
+	else if (wpa_driver_events_subscribed(DRIVER_EVENT_RSSI))
+		wpa_driver_wext_signal_sample(drv, &sample);
+}
+
+/*
+ * Forget the link once it went down and start periodic sampling when RSSI
+ * events got subscribers. The timer keeps itself going until the link goes
+ * down or the last subscriber is gone.
+ */
+static void wpa_driver_wext_signal_check(struct wpa_driver_wext_data *drv)
+{
+	struct signal_sample sample;
+
+	if (!wpa_driver_wext_signal_link_up(drv))
+		wpa_driver_wext_signal_stop();
+	else if (wpa_driver_events_subscribed(DRIVER_EVENT_RSSI) &&
+		 !eloop_is_timeout_registered(wpa_driver_wext_signal_timer,
+					      &wext_timer, NULL))
+		wpa_driver_wext_signal_sample(drv, &sample);
+}
+
+/* Start sampling for a new RSSI subscriber before the next library call */
+static void wpa_driver_wext_events_subscribed(void)
+{
+	struct wpa_driver_wext_data *drv = wpa_driver_wext_timer_drv();
+
+	if (drv)
+		wpa_driver_wext_signal_check(drv);
+}
+
+/*
+ * Answer RSSI and LINKSPEED from the signal sample, in the format of the
+ * driver. Returns -1 if the driver has to be asked.
+ */
+static int wpa_driver_wext_signal_reply(struct wpa_driver_wext_data *drv,
+					const char *cmd, char *buf,
+					size_t buf_len)
+{
+	struct wpa_supplicant *wpa_s = (struct wpa_supplicant *)(drv->ctx);
+	struct signal_sample sample;
+
+	if (wpa_driver_wext_signal_get(drv, &sample) < 0 || !sample.valid)
+		return -1;
+	if (os_strcasecmp(cmd, LINKSPEED_CMD) == 0)
+		return os_snprintf(buf, buf_len, "LinkSpeed %d\n",
+				   sample.txrate / 1000);
+	if (wpa_s->current_ssid == NULL)
+		return -1;
+	return os_snprintf(buf, buf_len, "%s rssi %d\n",
+			   wpa_ssid_txt(wpa_s->current_ssid->ssid,
+					wpa_s->current_ssid->ssid_len),
+			   sample.rssi);
+}
+
+/* Stop the timers of this library and the scans they wait for */
+static void wpa_driver_wext_timers_stop(void)
+{
+	wpa_driver_wext_timer_cancel(wpa_driver_wext_predict_scan);
+	wpa_driver_wext_timer_cancel(wpa_driver_wext_scan_poll);
+	wpa_driver_scan_cost_stop();
+	wpa_driver_wext_signal_stop();
+}
+
+/*
+ * Guess which component asked for a scan: a scan for the SSID of the current
+ * network while associated comes from bgscan, a scan for a specific SSID
+ * while not associated is a connection attempt and anything else is treated
+ * as a framework scan.
+ */
+static enum scan_cost_requester
+wpa_driver_wext_scan_requester(struct wpa_supplicant *wpa_s,
+			       const u8 *ssid, size_t ssid_len)
+{
+	if (wpa_s->wpa_state >= WPA_ASSOCIATED) {
+		if (wpa_s->current_ssid && ssid_len &&
+		    ssid_len == wpa_s->current_ssid->ssid_len &&
+		    os_memcmp(ssid, wpa_s->current_ssid->ssid, ssid_len) == 0)
+			return SCAN_COST_BGSCAN;
+		return SCAN_COST_FRAMEWORK;
+	}
+	if (ssid_len)
+		return SCAN_COST_CONNECT;
+	return SCAN_COST_FRAMEWORK;
+}
 
 /**
  * wpa_driver_wext_set_scan_timeout - Set scan timeout to report scan completion
  * @priv:  Pointer to private wext data from wpa_driver_wext_init()
+ * Returns: Scan timeout in seconds
  *
  * This function can be used to set registered timeout when starting a scan to
  * generate a scan completed event if the driver does not report this.
  */
-static void wpa_driver_wext_set_scan_timeout(void *priv)
+static int wpa_driver_wext_set_scan_timeout(void *priv)
 {
 	struct wpa_driver_wext_data *drv = priv;
-	int timeout = 10; /* In case scan A and B bands it can be long */
+	/* In case scan A and B bands it can be long */
+	int timeout = wpa_driver_profile_get()->scan_timeout;
 
 	/* Not all drivers generate "scan completed" wireless event, so try to
 	 * read results after a timeout. */
@@ -52,13 +536,15 @@ static void wpa_driver_wext_set_scan_timeout(void *priv)
 	 * when scan is complete, so use longer timeout to avoid race
 	 * conditions with scanning and following association request.
 	 */
-		timeout = 30;
+		timeout = wpa_driver_profile_get()->scan_timeout_events;
 	}
 	wpa_printf(MSG_DEBUG, "Scan requested - scan timeout %d seconds",
 		   timeout);
 	eloop_cancel_timeout(wpa_driver_wext_scan_timeout, drv, drv->ctx);
 	eloop_register_timeout(timeout, 0, wpa_driver_wext_scan_timeout, drv,
 			       drv->ctx);
+	wpa_driver_wext_scan_poll_start(drv, timeout);
+	return timeout;
 }
 
 /**
@@ -70,6 +556,7 @@ static void wpa_driver_wext_set_scan_timeout(void *priv)
 int wpa_driver_wext_combo_scan(void *priv, struct wpa_driver_scan_params *params)
 {
 	struct wpa_driver_wext_data *drv = priv;
+	struct wpa_supplicant *wpa_s = (struct wpa_supplicant *)(drv->ctx);
 	struct iwreq iwr;
 	int ret = 0, timeout;
 	struct iw_scan_req req;
@@ -82,6 +569,8 @@ int wpa_driver_wext_combo_scan(void *priv, struct wpa_driver_scan_params *params
 		return -1;
 	}
 
+	wpa_driver_wext_check_scan_results(drv);
+
 	os_memset(&iwr, 0, sizeof(iwr));
 	os_strlcpy(iwr.ifr_name, drv->ifname, IFNAMSIZ);
 
@@ -96,21 +585,21 @@ int wpa_driver_wext_combo_scan(void *priv, struct wpa_driver_scan_params *params
 		iwr.u.data.flags = IW_SCAN_THIS_ESSID;
 	}
 
-	if (ioctl(drv->ioctl_sock, SIOCSIWSCAN, &iwr) < 0) {
+	if (wpa_driver_wext_ioctl(drv, SIOCSIWSCAN, &iwr) < 0) {
 		wpa_printf(MSG_ERROR, "ioctl[SIOCSIWSCAN]");
 		ret = -1;
 	}
 
 	/* Not all drivers generate "scan completed" wireless event, so try to
 	 * read results after a timeout. */
-	timeout = 10;
+	timeout = wpa_driver_profile_get()->scan_timeout;
 	if (drv->scan_complete_events) {
 		/*
 		 * The driver seems to deliver SIOCGIWSCAN events to notify
 		 * when scan is complete, so use longer timeout to avoid race
 		 * conditions with scanning and following association request.
 		 */
-		timeout = 30;
+		timeout = wpa_driver_profile_get()->scan_timeout_events;
 	}
 	wpa_printf(MSG_DEBUG, "Scan requested (ret=%d) - scan timeout %d "
 		   "seconds", ret, timeout);
@@ -118,14 +607,22 @@ int wpa_driver_wext_combo_scan(void *priv, struct wpa_driver_scan_params *params
 	eloop_register_timeout(timeout, 0, wpa_driver_wext_scan_timeout, drv,
 			       drv->ctx);
 
+	if (ret == 0) {
+		wpa_driver_scan_cost_start(
+			wpa_driver_wext_scan_requester(wpa_s, ssid, ssid_len),
+			timeout, wpa_s->wpa_state >= WPA_ASSOCIATED);
+		wpa_driver_wext_scan_poll_start(drv, timeout);
+	}
+
 	return ret;
 }
 
 static int wpa_driver_wext_set_cscan_params(char *buf, size_t buf_len, char *cmd)
 {
+	const struct driver_profile *profile = wpa_driver_profile_get();
 	char *pasv_ptr;
 	int bp, i;
-	u16 pasv_dwell = WEXT_CSCAN_PASV_DWELL_TIME_DEF;
+	u16 pasv_dwell = profile->cscan_pasv_dwell;
 	u8 channel;
 
 	wpa_printf(MSG_DEBUG, "%s: %s", __func__, cmd);
@@ -137,7 +634,7 @@ static int wpa_driver_wext_set_cscan_params(char *buf, size_t buf_len, char *cmd
 		pasv_ptr += 6;
 		pasv_dwell = (u16)atoi(pasv_ptr);
 		if (pasv_dwell == 0)
-			pasv_dwell = WEXT_CSCAN_PASV_DWELL_TIME_DEF;
+			pasv_dwell = profile->cscan_pasv_dwell;
 	}
 	channel = (u8)atoi(cmd + 5);
 
@@ -148,7 +645,7 @@ static int wpa_driver_wext_set_cscan_params(char *buf, size_t buf_len, char *cmd
 	buf[bp++] = WEXT_CSCAN_CHANNEL_SECTION;
 	buf[bp++] = channel;
 	if (channel != 0) {
-		i = (pasv_dwell - 1) / WEXT_CSCAN_PASV_DWELL_TIME_DEF;
+		i = (pasv_dwell - 1) / profile->cscan_pasv_dwell;
 		for (; i > 0; i--) {
 			if ((size_t)(bp + 12) >= buf_len)
 				break;
@@ -156,15 +653,15 @@ static int wpa_driver_wext_set_cscan_params(char *buf, size_t buf_len, char *cmd
 			buf[bp++] = channel;
 		}
 	} else {
-		if (pasv_dwell > WEXT_CSCAN_PASV_DWELL_TIME_MAX)
-			pasv_dwell = WEXT_CSCAN_PASV_DWELL_TIME_MAX;
+		if (pasv_dwell > profile->cscan_pasv_dwell_max)
+			pasv_dwell = profile->cscan_pasv_dwell_max;
 	}
 
 	/* Set passive dwell time (default is 250) */
 	buf[bp++] = WEXT_CSCAN_PASV_DWELL_SECTION;
 	if (channel != 0) {
-		buf[bp++] = (u8)WEXT_CSCAN_PASV_DWELL_TIME_DEF;
-		buf[bp++] = (u8)(WEXT_CSCAN_PASV_DWELL_TIME_DEF >> 8);
+		buf[bp++] = (u8)profile->cscan_pasv_dwell;
+		buf[bp++] = (u8)(profile->cscan_pasv_dwell >> 8);
 	} else {
 		buf[bp++] = (u8)pasv_dwell;
 		buf[bp++] = (u8)(pasv_dwell >> 8);
@@ -172,8 +669,8 @@ static int wpa_driver_wext_set_cscan_params(char *buf, size_t buf_len, char *cmd
 
 	/* Set home dwell time (default is 40) */
 	buf[bp++] = WEXT_CSCAN_HOME_DWELL_SECTION;
-	buf[bp++] = (u8)WEXT_CSCAN_HOME_DWELL_TIME;
-	buf[bp++] = (u8)(WEXT_CSCAN_HOME_DWELL_TIME >> 8);
+	buf[bp++] = (u8)profile->cscan_home_dwell;
+	buf[bp++] = (u8)(profile->cscan_home_dwell >> 8);
 
 	/* Set cscan type */
 	buf[bp++] = WEXT_CSCAN_TYPE_SECTION;
@@ -195,6 +692,7 @@ static char *wpa_driver_get_country_code(int channels)
 static int wpa_driver_set_backgroundscan_params(void *priv)
 {
 	struct wpa_driver_wext_data *drv = priv;
+	const struct driver_profile *profile = wpa_driver_profile_get();
 	struct wpa_supplicant *wpa_s;
 	struct iwreq iwr;
 	int ret = 0, i = 0, bp;
@@ -238,16 +736,19 @@ static int wpa_driver_set_backgroundscan_params(void *priv)
 		ssid_conf = ssid_conf->next;
 	}
 
+	wext_pno_interval = wpa_driver_mobility_scan_interval(profile->pno_interval,
+							      WEXT_PNO_SCAN_INTERVAL_MIN,
+							      WEXT_PNO_SCAN_INTERVAL_MAX);
 	buf[bp++] = WEXT_PNO_SCAN_INTERVAL_SECTION;
-	os_snprintf(&buf[bp], WEXT_PNO_SCAN_INTERVAL_LENGTH + 1, "%x", WEXT_PNO_SCAN_INTERVAL);
+	os_snprintf(&buf[bp], WEXT_PNO_SCAN_INTERVAL_LENGTH + 1, "%02x", wext_pno_interval);
 	bp += WEXT_PNO_SCAN_INTERVAL_LENGTH;
 
 	buf[bp++] = WEXT_PNO_REPEAT_SECTION;
-	os_snprintf(&buf[bp], WEXT_PNO_REPEAT_LENGTH + 1, "%x", WEXT_PNO_REPEAT);
+	os_snprintf(&buf[bp], WEXT_PNO_REPEAT_LENGTH + 1, "%x", profile->pno_repeat);
 	bp += WEXT_PNO_REPEAT_LENGTH;
 
 	buf[bp++] = WEXT_PNO_MAX_REPEAT_SECTION;
-	os_snprintf(&buf[bp], WEXT_PNO_MAX_REPEAT_LENGTH + 1, "%x", WEXT_PNO_MAX_REPEAT);
+	os_snprintf(&buf[bp], WEXT_PNO_MAX_REPEAT_LENGTH + 1, "%x", profile->pno_max_repeat);
 	bp += WEXT_PNO_MAX_REPEAT_LENGTH + 1;
 
 	os_memset(&iwr, 0, sizeof(iwr));
@@ -255,14 +756,14 @@ static int wpa_driver_set_backgroundscan_params(void *priv)
 	iwr.u.data.pointer = buf;
 	iwr.u.data.length = bp;
 
-	ret = ioctl(drv->ioctl_sock, SIOCSIWPRIV, &iwr);
+	ret = wpa_driver_wext_ioctl(drv, SIOCSIWPRIV, &iwr);
 
 	if (ret < 0) {
 		wpa_printf(MSG_ERROR, "ioctl[SIOCSIWPRIV] (pnosetup): %d", ret);
 		drv->errors++;
-		if (drv->errors > DRV_NUMBER_SEQUENTIAL_ERRORS) {
+		if (drv->errors > wpa_driver_profile_get()->sequential_errors) {
 			drv->errors = 0;
-			wpa_msg(drv->ctx, MSG_INFO, WPA_EVENT_DRIVER_STATE "HANGED");
+			wpa_driver_wext_send_hanged(drv);
 		}
 	} else {
 		drv->errors = 0;
@@ -280,24 +781,36 @@ int wpa_driver_wext_driver_cmd( void *priv, char *cmd, char *buf, size_t buf_len
 
 	wpa_printf(MSG_DEBUG, "%s %s len = %d", __func__, cmd, buf_len);
 
+	wpa_driver_metrics_init(drv->ifname);
+	wpa_driver_wext_timer_attach(drv);
+	wpa_driver_events_init(drv->ifname, wpa_driver_wext_events_subscribed);
+
 	if (!drv->driver_is_started && (os_strcasecmp(cmd, "START") != 0)) {
 		wpa_printf(MSG_ERROR,"WEXT: Driver not initialized yet");
 		return -1;
 	}
 
+	wpa_driver_wext_check_scan_results(drv);
+	wpa_driver_predict_link_check(wpa_s);
+	wpa_driver_wext_signal_check(drv);
+
 	if (os_strcasecmp(cmd, "RSSI-APPROX") == 0) {
 		os_strncpy(cmd, RSSI_CMD, MAX_DRV_CMD_SIZE);
 	} else if( os_strncasecmp(cmd, "SCAN-CHANNELS", 13) == 0 ) {
 		int no_of_chan;
 
 		no_of_chan = atoi(cmd + 13);
+		if (no_of_chan > 0)
+			wext_scan_channels = no_of_chan;
 		os_snprintf(cmd, MAX_DRV_CMD_SIZE, "COUNTRY %s",
 			wpa_driver_get_country_code(no_of_chan));
+	} else if (os_strcasecmp(cmd, "START") == 0) {
+		wpa_driver_profile_load();
 	} else if (os_strcasecmp(cmd, "STOP") == 0) {
 		linux_set_iface_flags(drv->ioctl_sock, drv->ifname, 0);
 	} else if( os_strcasecmp(cmd, "RELOAD") == 0 ) {
 		wpa_printf(MSG_DEBUG,"Reload command");
-		wpa_msg(drv->ctx, MSG_INFO, WPA_EVENT_DRIVER_STATE "HANGED");
+		wpa_driver_wext_send_hanged(drv);
 		return ret;
 	} else if( os_strcasecmp(cmd, "BGSCAN-START") == 0 ) {
 		ret = wpa_driver_set_backgroundscan_params(priv);
@@ -306,9 +819,36 @@ int wpa_driver_wext_driver_cmd( void *priv, char *cmd, char *buf, size_t buf_len
 		}
 		os_strncpy(cmd, "PNOFORCE 1", MAX_DRV_CMD_SIZE);
 		drv->bgscan_enabled = 1;
+		wpa_driver_scan_cost_pno(1, wext_scan_channels,
+					 wext_pno_interval);
 	} else if( os_strcasecmp(cmd, "BGSCAN-STOP") == 0 ) {
 		os_strncpy(cmd, "PNOFORCE 0", MAX_DRV_CMD_SIZE);
 		drv->bgscan_enabled = 0;
+		wpa_driver_scan_cost_pno(0, wext_scan_channels,
+					 wext_pno_interval);
+	} else if (os_strncasecmp(cmd, SCAN_DELTA_CMD, SCAN_DELTA_CMD_SIZE) == 0) {
+		return wpa_driver_scan_delta_cmd(cmd, buf, buf_len);
+	} else if (os_strncasecmp(cmd, SIG_HIST_CMD, SIG_HIST_CMD_SIZE) == 0) {
+		return wpa_driver_sig_hist_cmd(cmd, buf, buf_len);
+	} else if (os_strncasecmp(cmd, SCAN_COST_CMD, SCAN_COST_CMD_SIZE) == 0) {
+		return wpa_driver_scan_cost_cmd(cmd, buf, buf_len);
+	} else if (os_strcasecmp(cmd, MOBILITY_CMD) == 0) {
+		return wpa_driver_mobility_cmd(buf, buf_len);
+	} else if (os_strncasecmp(cmd, PREDICT_CMD, PREDICT_CMD_SIZE) == 0) {
+		return wpa_driver_predict_cmd(cmd, buf, buf_len,
+					      wext_scan_channels);
+	} else if (os_strcasecmp(cmd, PROFILE_CMD) == 0) {
+		return wpa_driver_profile_cmd(buf, buf_len);
+	} else if (os_strcasecmp(cmd, SIGNAL_CMD) == 0) {
+		return wpa_driver_signal_cmd(buf, buf_len);
+	}
+
+	if (os_strcasecmp(cmd, RSSI_CMD) == 0 ||
+	    os_strcasecmp(cmd, LINKSPEED_CMD) == 0) {
+		ret = wpa_driver_wext_signal_reply(drv, cmd, buf, buf_len);
+		if (ret >= 0)
+			return ret;
+		ret = 0;
 	}
 
 	os_memset(&iwr, 0, sizeof(iwr));
@@ -326,11 +866,18 @@ int wpa_driver_wext_driver_cmd( void *priv, char *cmd, char *buf, size_t buf_len
 			return ret;
 		}
 	}
-	ret = ioctl(drv->ioctl_sock, SIOCSIWPRIV, &iwr);
+	ret = wpa_driver_wext_ioctl(drv, SIOCSIWPRIV, &iwr);
 
 	if (ret < 0) {
 		wpa_printf(MSG_DEBUG, "%s failed (%d): %s", __func__, ret, cmd);
+	} else if (os_strncasecmp(cmd, "CSCAN", 5) == 0) {
+		/* Only scans the driver accepted use the radio */
+		wpa_driver_scan_cost_cscan(SCAN_COST_FRAMEWORK, buf,
+					   iwr.u.data.length,
+					   wext_scan_channels,
+					   wpa_s->wpa_state >= WPA_ASSOCIATED);
 	}
+	wpa_driver_metrics_driver_cmd(ret < 0);
 
     //
     // All command fail. (Allways OK for USB Dongle)
@@ -340,9 +887,9 @@ int wpa_driver_wext_driver_cmd( void *priv, char *cmd, char *buf, size_t buf_len
 	if (ret < 0) {
 		wpa_printf(MSG_ERROR, "%s failed (%d): %s", __func__, ret, cmd);
 		drv->errors++;
-		if (drv->errors > DRV_NUMBER_SEQUENTIAL_ERRORS) {
+		if (drv->errors > wpa_driver_profile_get()->sequential_errors) {
 			drv->errors = 0;
-			wpa_msg(drv->ctx, MSG_INFO, WPA_EVENT_DRIVER_STATE "HANGED");
+			wpa_driver_wext_send_hanged(drv);
 		}
 	} else {
 		drv->errors = 0;
@@ -356,10 +903,13 @@ int wpa_driver_wext_driver_cmd( void *priv, char *cmd, char *buf, size_t buf_len
 		} else if (os_strcasecmp(cmd, "START") == 0) {
 			drv->driver_is_started = TRUE;
 			linux_set_iface_flags(drv->ioctl_sock, drv->ifname, 1);
+			wpa_driver_events_publish(DRIVER_EVENT_STATE, 0, 1, 0);
 			/* os_sleep(0, WPA_DRIVER_WEXT_WAIT_US);
 			wpa_msg(drv->ctx, MSG_INFO, WPA_EVENT_DRIVER_STATE "STARTED"); */
 		} else if (os_strcasecmp(cmd, "STOP") == 0) {
 			drv->driver_is_started = FALSE;
+			wpa_driver_wext_timers_stop();
+			wpa_driver_events_publish(DRIVER_EVENT_STATE, 0, 0, 0);
 			/* wpa_msg(drv->ctx, MSG_INFO, WPA_EVENT_DRIVER_STATE "STOPPED"); */
 		} else if (os_strncasecmp(cmd, "CSCAN", 5) == 0) {
 			wpa_driver_wext_set_scan_timeout(priv);
@@ -367,13 +917,23 @@ int wpa_driver_wext_driver_cmd( void *priv, char *cmd, char *buf, size_t buf_len
 		}
 		wpa_printf(MSG_DEBUG, "%s %s len = %d, %d", __func__, buf, ret, strlen(buf));
 	}
+	wpa_driver_metrics_state(drv->driver_is_started, drv->bgscan_enabled,
+				 drv->errors);
 	return ret;
 }
 
 int wpa_driver_signal_poll(void *priv, struct wpa_signal_info *si)
 {
-    // fix
-	si->current_signal = -60;
-	si->current_txrate = 150 * 1000;
+	struct wpa_driver_wext_data *drv = priv;
+	struct signal_sample sample;
+
+	wpa_driver_metrics_signal_poll();
+	wpa_driver_wext_check_scan_results(drv);
+	wpa_driver_predict_link_check(drv->ctx);
+
+	/* Fixed values unless the driver reports statistics */
+	wpa_driver_wext_signal_get(drv, &sample);
+	si->current_signal = sample.rssi;
+	si->current_txrate = sample.txrate;
 	return 0;
 }
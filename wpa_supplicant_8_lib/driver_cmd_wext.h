@@ -35,4 +35,8 @@
 #define WEXT_CSCAN_PASV_DWELL_TIME_MAX	3000
 #define WEXT_CSCAN_HOME_DWELL_TIME	130
 
+/* Limits of the wpa_supplicant scan interval adapted to mobility (seconds) */
+#define WEXT_SCAN_INTERVAL_MIN		2
+#define WEXT_SCAN_INTERVAL_MAX		300
+
 #endif /* DRIVER_CMD_WEXT_H */